@@ -103,29 +103,41 @@ bool AutoAnnotator::taskIsEmpty(int taskId) {
 	return true;
 }
 
+bool AutoAnnotator::nodeIsEmpty(int nodeId) {
+    for (int d = 0; d < mDimension; ++d) {
+        if (mQueues[nodeId * mDimension + d] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+    Searches the assignments of the live tasks from mLiveTasks[position] on.
+
+    Blank tasks stay unassigned and are never visited, a blank node can't take any live task
+    (it has nothing of a resource the task needs) so only the live nodes are tried.
+    Both are visited in the original order, so the first optimum found is the same.
+*/
 void AutoAnnotator::calculateOptimum(std::vector<int>& workQueue,
                                      std::vector<int>& distribution,
-                                     int taskId) {
-    
-    if (taskId == mLength) {
+                                     int position) {
+    ++mExploredNodes;
+
+    if (position == (int)mLiveTasks.size()) {
         checkAndSaveDistribution(distribution);
         return;
     }
 
-    if (taskIsEmpty(taskId)) {
-    	calculateOptimum(workQueue, distribution, taskId + 1);
-    	return;
-    }
-
-    // need step when task is not assigned!
-    for (int i = 0; i <= mLength; ++i) {
+    int taskId = mLiveTasks[position];
+    for (int i : mLiveNodes) {
         if (tryAssignTaskToNode(workQueue, taskId, i)) {
             distribution[taskId] = i;
-            calculateOptimum(workQueue, distribution, taskId + 1);
+            calculateOptimum(workQueue, distribution, position + 1);
             removeAssignedTaskFromNode(workQueue, taskId, i);
             distribution[taskId] = mLength;
         }
     }
-
-    return;
-}
\ No newline at end of file
+    // need step when task is not assigned!
+    calculateOptimum(workQueue, distribution, position + 1);
+}
@@ -11,10 +11,15 @@ private:
     int mLength;
     std::vector<int> mBestDistribution;
     int mBestWaste;
+    long mExploredNodes = 0;
+    // the search only visits the jobs and nodes that aren't blank (all zero resources)
+    std::vector<int> mLiveTasks;
+    std::vector<int> mLiveNodes;
 
     bool taskIsEmpty(int taskId);
+    bool nodeIsEmpty(int nodeId);
     int calculateWaste(const std::vector<int>& distribution);
-    void calculateOptimum(std::vector<int>& workQueue, std::vector<int>& distribution, int taskId);
+    void calculateOptimum(std::vector<int>& workQueue, std::vector<int>& distribution, int position);
     std::vector<int> formatDistribution(std::vector<int> distribution);
     bool tryAssignTaskToNode(std::vector<int>& workQueue, int taskId, int nodeId);
     void removeAssignedTaskFromNode(std::vector<int>& workQueue, int taskId, int nodeId);
@@ -24,11 +29,23 @@ public:
     : mQueues(queues), mDimension(dimension), mLength(queues.size() / 2 / dimension) {
         mBestDistribution = std::vector<int>(mLength, mLength);
         mBestWaste = calculateWaste(mBestDistribution);
+        for (int i = 0; i < mLength; ++i) {
+            if (!taskIsEmpty(i)) {
+                mLiveTasks.push_back(i);
+            }
+            if (!nodeIsEmpty(i)) {
+                mLiveNodes.push_back(i);
+            }
+        }
     }
     /**
         Calculates one optimal solution.
     */
     std::vector<int> annotate();
+    /**
+        Number of search tree nodes visited by annotate(). Blank jobs aren't part of the tree.
+    */
+    long getExploredNodes() const {return mExploredNodes;}
     /**
         Pretty prints the stored best distribution.
     */
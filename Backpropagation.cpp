@@ -0,0 +1,155 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include "Backpropagation.h"
+#include "Gemm.h"
+
+namespace {
+
+// samples per forward and backward pass of a thread, the activations stay in L2
+const int BatchSize = 128;
+// smallest range worth a thread
+const long MinSamplesPerThread = 64;
+
+double sigmoid(double z) {
+    return 1 / (1 + std::exp(-z));
+}
+
+/**
+    log(1 + exp(z)) without overflow, -log(1 - sigmoid(z)).
+*/
+double softplus(double z) {
+    return std::max(z, 0.) + std::log1p(std::exp(-std::fabs(z)));
+}
+
+/**
+    Cost and unscaled gradient of samples [first, last).
+*/
+void accumulate(const double* parameters, const double* outputRows, const Layers& layers, long first, long last,
+                const BatchLoader& load, BatchWorkspace& workspace) {
+    int inputs = layers.inputs;
+    workspace.inputs.resize((size_t)BatchSize * (inputs + 1));
+    workspace.targets.resize((size_t)BatchSize * layers.outputs);
+    workspace.gradient.assign(layers.parameters(), 0);
+    workspace.cost = 0;
+    for (int r = 0; r < BatchSize; ++r) {
+        workspace.inputs[(size_t)r * (inputs + 1)] = 1;
+    }
+    for (long begin = first; begin < last; begin += BatchSize) {
+        int rows = (int)std::min((long)BatchSize, last - begin);
+        load(begin, rows, workspace.inputs.data(), workspace.targets.data());
+        workspace.cost += backpropagate(parameters, outputRows, layers, workspace.inputs.data(),
+                                        workspace.targets.data(), rows, workspace.gradient.data(), workspace.scratch);
+    }
+}
+
+}
+
+void outputRows(const double* parameters, const Layers& layers, std::vector<double>& rows) {
+    rows.resize((size_t)layers.outputs * layers.hidden);
+    // rows 1.. of Theta2' transposed
+    transpose(parameters + layers.firstLayer() + layers.outputs, rows.data(), layers.hidden, layers.outputs);
+}
+
+double backpropagate(const double* parameters, const double* outputRows, const Layers& layers,
+                     const double* inputs, const double* targets, int count, double* gradient,
+                     BackpropagationScratch& scratch) {
+    int hidden = layers.hidden;
+    int outputs = layers.outputs;
+    const double* weights1 = parameters;
+    const double* weights2 = parameters + layers.firstLayer();
+    scratch.hidden.resize((size_t)count * hidden);
+    scratch.activations.resize((size_t)count * (hidden + 1));
+    scratch.output.resize((size_t)count * outputs);
+    scratch.hiddenDelta.resize((size_t)count * hidden);
+
+    // A2 = [1 sigmoid(A1 * Theta1')]
+    multiply(inputs, weights1, scratch.hidden.data(), count, layers.inputs + 1, hidden);
+    for (int r = 0; r < count; ++r) {
+        const double* z = scratch.hidden.data() + (size_t)r * hidden;
+        double* row = scratch.activations.data() + (size_t)r * (hidden + 1);
+        row[0] = 1;
+        for (int h = 0; h < hidden; ++h) {
+            row[h + 1] = sigmoid(z[h]);
+        }
+    }
+    // Z3 = A2 * Theta2', D3 = sigmoid(Z3) - y
+    multiply(scratch.activations.data(), weights2, scratch.output.data(), count, hidden + 1, outputs);
+    double cost = 0;
+    for (size_t i = 0; i < (size_t)count * outputs; ++i) {
+        double z = scratch.output[i];
+        double y = targets[i];
+        if (y == 0) {
+            cost += softplus(z);
+        } else {
+            // -log(sigmoid(z)) == softplus(-z)
+            cost += y * softplus(-z);
+        }
+        scratch.output[i] = sigmoid(z) - y;
+    }
+    // D2 = D3 * Theta2(:, 2:end) .* sigmoidGradient(Z2)
+    multiply(scratch.output.data(), outputRows, scratch.hiddenDelta.data(), count, outputs, hidden);
+    for (int r = 0; r < count; ++r) {
+        double* delta = scratch.hiddenDelta.data() + (size_t)r * hidden;
+        const double* a = scratch.activations.data() + (size_t)r * (hidden + 1) + 1;
+        for (int h = 0; h < hidden; ++h) {
+            delta[h] *= a[h] * (1 - a[h]);
+        }
+    }
+    // Theta1_grad' += A1' * D2, Theta2_grad' += A2' * D3
+    accumulateTransposed(inputs, scratch.hiddenDelta.data(), gradient, count, layers.inputs + 1, hidden,
+                         scratch.transposed);
+    accumulateTransposed(scratch.activations.data(), scratch.output.data(), gradient + layers.firstLayer(),
+                         count, hidden + 1, outputs, scratch.transposed);
+    return cost;
+}
+
+double regularize(const double* parameters, const Layers& layers, double lambda, double* gradient) {
+    double sum = 0;
+    // the bias column of Theta is the first row of Theta'
+    size_t first = layers.firstLayer();
+    for (size_t i = layers.hidden; i < first; ++i) {
+        sum += parameters[i] * parameters[i];
+        gradient[i] += lambda * parameters[i];
+    }
+    for (size_t i = first + layers.outputs; i < layers.parameters(); ++i) {
+        sum += parameters[i] * parameters[i];
+        gradient[i] += lambda * parameters[i];
+    }
+    return lambda / 2 * sum;
+}
+
+double backpropagateParallel(const double* parameters, const Layers& layers, long count, int threads,
+                             const BatchLoader& load, double* gradient, ParallelScratch& scratch) {
+    count = std::max(0L, count);
+    outputRows(parameters, layers, scratch.outputRows);
+    threads = (int)std::max(1L, std::min((long)std::max(1, threads), count / MinSamplesPerThread));
+    if ((int)scratch.workspaces.size() < threads) {
+        scratch.workspaces.resize(threads);
+    }
+
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; ++t) {
+        workers.emplace_back(accumulate, parameters, scratch.outputRows.data(), std::cref(layers),
+                             count * t / threads, count * (t + 1) / threads, std::cref(load),
+                             std::ref(scratch.workspaces[t]));
+    }
+    accumulate(parameters, scratch.outputRows.data(), layers, 0, count / threads, load, scratch.workspaces[0]);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    std::fill(gradient, gradient + layers.parameters(), 0.);
+    double cost = 0;
+    for (int t = 0; t < threads; ++t) {
+        const auto& workspace = scratch.workspaces[t];
+        cost += workspace.cost;
+        for (size_t i = 0; i < layers.parameters(); ++i) {
+            gradient[i] += workspace.gradient[i];
+        }
+    }
+    return cost;
+}
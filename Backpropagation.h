@@ -0,0 +1,107 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+/**
+    Layer sizes of the network of octave/nnCostFunction.m.
+
+    Parameters are unrolled like in Octave, [Theta1(:); Theta2(:)]. That is column major, so
+    Theta1(:) read row major is Theta1', an (inputs + 1) x hidden matrix whose rows are the weights
+    of one input (the first row is the bias). The forward pass is then [1 X] * Theta1' as a row
+    major GEMM without any reshaping, and the gradient is [1 X]' * D2 in the same layout.
+*/
+struct Layers {
+    int inputs = 0;
+    int hidden = 0;
+    int outputs = 0;
+
+    Layers(int inputs, int hidden, int outputs) : inputs(inputs), hidden(hidden), outputs(outputs) {
+        // empty
+    }
+
+    // items of Theta1
+    size_t firstLayer() const {return (size_t)hidden * (inputs + 1);}
+    // items of [Theta1(:); Theta2(:)]
+    size_t parameters() const {return firstLayer() + (size_t)outputs * (hidden + 1);}
+};
+
+/**
+    Reusable buffers of backpropagate().
+*/
+struct BackpropagationScratch {
+    std::vector<double> hidden;
+    std::vector<double> activations;
+    std::vector<double> output;
+    std::vector<double> hiddenDelta;
+    std::vector<double> transposed;
+};
+
+/**
+    Writes Theta2(:, 2:end) (outputs x hidden, row major) of 'parameters' into 'rows', the weights
+    the output errors are propagated back through. Computed once per parameter vector.
+*/
+void outputRows(const double* parameters, const Layers& layers, std::vector<double>& rows);
+
+/**
+    Forward and backward pass of a batch of 'count' samples.
+
+    'inputs' is [1 X] (count x (inputs + 1), row major, with the column of ones), 'targets' is y
+    (count x outputs). Adds the unscaled gradient of the batch to 'gradient' (unrolled layout)
+    and returns the sum of its cross-entropies, -y * log(h) - !y * log(1 - h) over every output
+    like nnCostFunction.m, computed from the pre-activations so it stays finite when h saturates.
+
+    The targets have to be 0 or 1 (one-hot labels). Like the !y of nnCostFunction.m, a fractional
+    target gets no log(1 - h) term, and the gradient h - y is the derivative of the cost only for
+    binary targets.
+*/
+double backpropagate(const double* parameters, const double* outputRows, const Layers& layers,
+                     const double* inputs, const double* targets, int count, double* gradient,
+                     BackpropagationScratch& scratch);
+
+/**
+    Adds lambda * Theta to 'gradient' for every weight but the biases, and returns
+    lambda / 2 * the sum of their squares.
+*/
+double regularize(const double* parameters, const Layers& layers, double lambda, double* gradient);
+
+/**
+    Writes samples [first, first + count) of a range into rows [0, count) of a batch: the features
+    into columns 1.. of 'inputs' (the bias column is set already) and every item of 'targets'.
+*/
+typedef std::function<void(long first, int count, double* inputs, double* targets)> BatchLoader;
+
+/**
+    Reusable buffers of a thread of backpropagateParallel().
+*/
+struct BatchWorkspace {
+    std::vector<double> inputs;
+    std::vector<double> targets;
+    std::vector<double> gradient;
+    double cost = 0;
+    BackpropagationScratch scratch;
+};
+
+/**
+    Reusable buffers of backpropagateParallel(), one workspace per thread.
+*/
+struct ParallelScratch {
+    std::vector<double> outputRows;
+    std::vector<BatchWorkspace> workspaces;
+};
+
+/**
+    Forward and backward pass of 'count' samples on up to 'threads' threads.
+
+    The samples are split into a contiguous range per thread (a thread gets at least 64 of them),
+    every thread loads and backpropagates its range in batches of 128 samples, so the activations
+    stay in L2, and the costs and gradients are summed in thread order. The result only depends on
+    the number of threads.
+
+    Writes the unscaled gradient into 'gradient' and returns the summed cross-entropy, see backpropagate().
+*/
+double backpropagateParallel(const double* parameters, const Layers& layers, long count, int threads,
+                             const BatchLoader& load, double* gradient, ParallelScratch& scratch);
@@ -0,0 +1,142 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#include <cstdio>
+#include <cstring>
+
+#include <unistd.h>
+
+#include "BaselineFile.h"
+#include "FileIO.h"
+
+namespace {
+
+const char Magic[8] = {'O', 'B', 'P', 'B', 'A', 'S', 'E', '\0'};
+const uint32_t Version = 3;
+
+struct BaselineHeader {
+    char magic[8];
+    uint32_t version;
+    int32_t length;
+    int32_t dimension;
+    int32_t heuristics;
+    uint64_t hash;
+    int64_t size;
+    int64_t samples;
+    uint64_t heuristicsHash;
+    char reserved[8];
+};
+
+static_assert(sizeof(BaselineHeader) == 64, "the records must stay aligned");
+
+BaselineHeader makeHeader(const BaselineKey& key, long samples) {
+    BaselineHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.length = key.length;
+    header.dimension = key.dimension;
+    header.heuristics = key.heuristics;
+    header.hash = key.hash;
+    header.size = key.size;
+    header.heuristicsHash = key.heuristicsHash;
+    header.samples = samples;
+    return header;
+}
+
+/**
+    Finalizer of MurmurHash3, every input bit affects every output bit.
+*/
+uint64_t mix(uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return value;
+}
+
+}
+
+uint64_t contentHash(const char* data, size_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        hash = mix(hash ^ word);
+    }
+    if (i < size) {
+        uint64_t word = 0;
+        std::memcpy(&word, data + i, size - i);
+        hash = mix(hash ^ word);
+    }
+    return hash;
+}
+
+uint64_t namesHash(const std::vector<std::string>& names) {
+    std::string text;
+    for (const auto& name : names) {
+        // the terminators keep ("ab", "c") and ("a", "bc") apart
+        text.append(name.c_str(), name.size() + 1);
+    }
+    return contentHash(text.data(), text.size());
+}
+
+BaselineFile::BaselineFile(const std::string& path, const BaselineKey& key) : mFile(path) {
+    if (!mFile.isOpen() || mFile.size() < sizeof(BaselineHeader)) {
+        return;
+    }
+    BaselineHeader header;
+    std::memcpy(&header, mFile.data(), sizeof(header));
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version
+        || header.hash != key.hash || header.size != key.size || header.length != key.length || header.dimension != key.dimension
+        || header.heuristics != key.heuristics || header.heuristicsHash != key.heuristicsHash || header.samples < 0) {
+        return;
+    }
+    size_t recordSize = sizeof(int32_t) * baselineStride(key.heuristics);
+    if (mFile.size() != sizeof(BaselineHeader) + recordSize * header.samples) {
+        return;
+    }
+    mSamples = header.samples;
+    mRecords = reinterpret_cast<const int32_t*>(mFile.data() + sizeof(BaselineHeader));
+}
+
+BaselineWriter::BaselineWriter(const std::string& path, const BaselineKey& key)
+: mPath(path), mKey(key) {
+    mFd = createTempFile(mPath, mTempPath);
+    // the number of samples is filled in by commit()
+    BaselineHeader header = makeHeader(mKey, 0);
+    mFailed = mFd < 0 || !writeAll(mFd, reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+BaselineWriter::~BaselineWriter() {
+    if (mFd >= 0) {
+        ::close(mFd);
+        ::unlink(mTempPath.c_str());
+    }
+}
+
+void BaselineWriter::append(const int32_t* records, long samples) {
+    if (mFailed) {
+        return;
+    }
+    size_t size = sizeof(int32_t) * baselineStride(mKey.heuristics) * samples;
+    mFailed = !writeAll(mFd, reinterpret_cast<const char*>(records), size);
+    mSamples += samples;
+}
+
+bool BaselineWriter::commit() {
+    if (mFailed) {
+        return false;
+    }
+    BaselineHeader header = makeHeader(mKey, mSamples);
+    bool ok = ::pwrite(mFd, &header, sizeof(header), 0) == (ssize_t)sizeof(header);
+    int fd = mFd;
+    mFd = -1;
+    if (!ok) {
+        ::close(fd);
+        ::unlink(mTempPath.c_str());
+        return false;
+    }
+    return replaceFile(fd, mTempPath, mPath);
+}
@@ -0,0 +1,102 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "FileIO.h"
+
+/**
+    Fields of a baseline record: the wastes of one sample that don't depend on the predictions.
+    The waste of every heuristic of allHeuristics() follows the fixed fields.
+*/
+enum BaselineField {
+    OptimumWaste = 0,
+    WorstWaste = 1,
+    FirstFitWaste = 2,
+    HeuristicWaste = 3
+};
+
+/**
+    Number of int32 fields of a baseline record.
+*/
+inline int baselineStride(int heuristicCount) {
+    return HeuristicWaste + heuristicCount;
+}
+
+/**
+    Content hash of a whole file. Every 8 byte word is xor-ed into the hash, which is then mixed
+    with the MurmurHash3 finalizer, so a change anywhere in a word affects every bit of the hash.
+*/
+uint64_t contentHash(const char* data, size_t size);
+
+/**
+    Hash of an ordered list of names, e.g. the heuristics of the baseline records.
+*/
+uint64_t namesHash(const std::vector<std::string>& names);
+
+/**
+    Identifies the training set a baseline sidecar belongs to.
+*/
+struct BaselineKey {
+    uint64_t hash = 0;
+    // of the training set file, in bytes
+    int64_t size = 0;
+    int32_t length = 0;
+    int32_t dimension = 0;
+    int32_t heuristics = 0;
+    // namesHash() of the heuristics, in the order of their fields
+    uint64_t heuristicsHash = 0;
+};
+
+/**
+    Read only, memory mapped baseline sidecar.
+
+    File layout: a 64 byte header (magic, version, key, number of samples) followed by
+    baselineStride() int32 fields per sample, in the order of the training set.
+*/
+class BaselineFile {
+private:
+    MappedFile mFile;
+    const int32_t* mRecords = nullptr;
+    long mSamples = 0;
+public:
+    /**
+        Maps 'path'. The file is ignored (isValid() is false) if it is missing, torn or belongs to another key.
+    */
+    BaselineFile(const std::string& path, const BaselineKey& key);
+
+    bool isValid() const {return mRecords != nullptr;}
+    long samples() const {return mSamples;}
+    const int32_t* records() const {return mRecords;}
+};
+
+/**
+    Writes a baseline sidecar next to a unique temporary name (createTempFile()) and renames it into place on commit(),
+    so readers never see a partial file. Uncommitted files are removed by the destructor.
+*/
+class BaselineWriter {
+private:
+    std::string mPath;
+    std::string mTempPath;
+    BaselineKey mKey;
+    int mFd = -1;
+    long mSamples = 0;
+    bool mFailed = false;
+public:
+    BaselineWriter(const std::string& path, const BaselineKey& key);
+    ~BaselineWriter();
+
+    BaselineWriter(const BaselineWriter&) = delete;
+    BaselineWriter& operator=(const BaselineWriter&) = delete;
+
+    void append(const int32_t* records, long samples);
+
+    /**
+        Returns false if the sidecar couldn't be written.
+    */
+    bool commit();
+};
@@ -0,0 +1,113 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#include <algorithm>
+
+#include "BatchFirstFit.h"
+#include "Features.h"
+
+/**
+    Transposes up to BatchLanes samples into the scratch, with the jobs in placement order.
+    Missing lanes get empty samples.
+
+    The placement order of a job is its rank: the number of jobs with a bigger harmonic mean, plus
+    the earlier ones with the same harmonic mean. That's the order of sortJobs(), but the ranks are
+    counted for all the lanes at once without branches, instead of sorting every sample on its own.
+*/
+static void loadLanes(const uint8_t* samples, int lanes, int length, int dimension, BatchScratch& scratch) {
+    int sampleSize = 2 * length * dimension;
+    std::fill(scratch.resources.begin(), scratch.resources.end(), 0);
+    std::fill(scratch.jobs.begin(), scratch.jobs.end(), 0);
+    std::fill(scratch.order.begin(), scratch.order.end(), 0);
+    std::fill(scratch.keys.begin(), scratch.keys.end(), 0);
+
+    for (int lane = 0; lane < lanes; ++lane) {
+        const uint8_t* sample = samples + (long)lane * sampleSize;
+        const uint8_t* jobs = sample + length * dimension;
+        for (int n = 0; n < length; ++n) {
+            for (int d = 0; d < dimension; ++d) {
+                scratch.resources[(n * dimension + d) * BatchLanes + lane] = sample[n * dimension + d];
+            }
+        }
+        for (int job = 0; job < length; ++job) {
+            scratch.keys[job * BatchLanes + lane] = harmonicMean(jobs + job * dimension, dimension);
+        }
+    }
+
+    for (int job = 0; job < length; ++job) {
+        const double* key = scratch.keys.data() + job * BatchLanes;
+        uint8_t* rank = scratch.ranks.data() + job * BatchLanes;
+        for (int lane = 0; lane < BatchLanes; ++lane) {
+            rank[lane] = 0;
+        }
+        // earlier jobs go first on ties, later ones only if they are bigger
+        for (int other = 0; other < job; ++other) {
+            const double* otherKey = scratch.keys.data() + other * BatchLanes;
+            for (int lane = 0; lane < BatchLanes; ++lane) {
+                rank[lane] += otherKey[lane] >= key[lane];
+            }
+        }
+        for (int other = job + 1; other < length; ++other) {
+            const double* otherKey = scratch.keys.data() + other * BatchLanes;
+            for (int lane = 0; lane < BatchLanes; ++lane) {
+                rank[lane] += otherKey[lane] > key[lane];
+            }
+        }
+    }
+
+    for (int lane = 0; lane < lanes; ++lane) {
+        const uint8_t* jobs = samples + (long)lane * sampleSize + length * dimension;
+        for (int job = 0; job < length; ++job) {
+            int rank = scratch.ranks[job * BatchLanes + lane];
+            scratch.order[rank * BatchLanes + lane] = job;
+            for (int d = 0; d < dimension; ++d) {
+                scratch.jobs[(rank * dimension + d) * BatchLanes + lane] = jobs[job * dimension + d];
+            }
+        }
+    }
+}
+
+void batchFirstFit(const uint8_t* samples, long sampleCount, int length, int dimension,
+                   uint8_t* assignments, BatchScratch& scratch) {
+    scratch.resources.resize(length * dimension * BatchLanes);
+    scratch.jobs.resize(length * dimension * BatchLanes);
+    scratch.order.resize(length * BatchLanes);
+    scratch.keys.resize(length * BatchLanes);
+    scratch.ranks.resize(length * BatchLanes);
+
+    for (long first = 0; first < sampleCount; first += BatchLanes) {
+        int lanes = std::min((long)BatchLanes, sampleCount - first);
+        loadLanes(samples + first * 2 * length * dimension, lanes, length, dimension, scratch);
+
+        for (int rank = 0; rank < length; ++rank) {
+            const uint8_t* job = scratch.jobs.data() + rank * dimension * BatchLanes;
+            uint8_t placed[BatchLanes] = {};
+            uint8_t chosen[BatchLanes] = {};
+            for (int n = 0; n < length; ++n) {
+                uint8_t* node = scratch.resources.data() + n * dimension * BatchLanes;
+                uint8_t fits[BatchLanes];
+                for (int lane = 0; lane < BatchLanes; ++lane) {
+                    fits[lane] = ~placed[lane];
+                }
+                for (int d = 0; d < dimension; ++d) {
+                    for (int lane = 0; lane < BatchLanes; ++lane) {
+                        fits[lane] &= -(uint8_t)(node[d * BatchLanes + lane] >= job[d * BatchLanes + lane]);
+                    }
+                }
+                // 'fits' is all ones in the lanes where the job goes to this node
+                for (int d = 0; d < dimension; ++d) {
+                    for (int lane = 0; lane < BatchLanes; ++lane) {
+                        node[d * BatchLanes + lane] -= job[d * BatchLanes + lane] & fits[lane];
+                    }
+                }
+                for (int lane = 0; lane < BatchLanes; ++lane) {
+                    chosen[lane] |= (uint8_t)(n + 1) & fits[lane];
+                    placed[lane] |= fits[lane];
+                }
+            }
+            const uint8_t* order = scratch.order.data() + rank * BatchLanes;
+            for (int lane = 0; lane < lanes; ++lane) {
+                assignments[(first + lane) * length + order[lane]] = chosen[lane];
+            }
+        }
+    }
+}
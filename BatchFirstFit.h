@@ -0,0 +1,41 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/**
+    Number of samples placed side by side by batchFirstFit().
+*/
+const int BatchLanes = 16;
+
+/**
+    Reusable buffers of batchFirstFit(), in structure of arrays layout.
+*/
+struct BatchScratch {
+    // [node][dimension][lane]
+    std::vector<uint8_t> resources;
+    // [job rank][dimension][lane], jobs in placement order
+    std::vector<uint8_t> jobs;
+    // [job rank][lane] original index of the job
+    std::vector<uint8_t> order;
+    // [job][lane] harmonic mean and rank of the job, in arrival order
+    std::vector<double> keys;
+    std::vector<uint8_t> ranks;
+};
+
+/**
+    Harmonic mean First Fit Decreasing for many samples at once, the same placement as
+    Heuristic(name, FitPolicy::FirstFit, SortKey::HarmonicMean).
+
+    'samples' holds 'sampleCount' samples in the training set layout, 2 * length * dimension
+    bytes each. The node of every job is written to 'assignments', 'length' items per sample.
+
+    BatchLanes samples are sorted and placed together: every rank comparison, capacity
+    check and update runs across the lanes without branches, so the compiler vectorizes it
+    (one byte per lane, a whole group fits into one 128 bit register).
+    The result is the same as placing the samples one by one.
+*/
+void batchFirstFit(const uint8_t* samples, long sampleCount, int length, int dimension,
+                   uint8_t* assignments, BatchScratch& scratch);
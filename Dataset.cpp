@@ -0,0 +1,387 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Dataset.h"
+#include "FileIO.h"
+#include "OctaveBinary.h"
+
+std::vector<int> vectorToBoolVector(const std::vector<int>& vec, int length) {
+    int size = vec.size();
+    std::vector<int> ret(size * length, 0);
+    for (int i = 0; i < size; ++i) {
+        ret[length * i + vec[i]] = 1;
+    }
+    return ret;
+}
+
+void writeRecord(std::ostream& os, const std::vector<int>& queues, const std::vector<int>& annotations) {
+    bool notFirst = false;
+    for (auto it = queues.cbegin(); it != queues.cend(); ++it) {
+        if (notFirst) {
+            os << " ";
+        }
+        os << *it;
+        notFirst = true;
+    }
+
+    for (auto it = annotations.cbegin(); it != annotations.cend(); ++it) {
+        os << ' ' << *it;
+    }
+
+    os << "\n";
+}
+
+/**
+    Lookup table of crc32(), built once by its function-local static (thread safe in C++11).
+*/
+struct Crc32Table {
+    uint32_t items[256];
+
+    Crc32Table() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            items[i] = c;
+        }
+    }
+};
+
+static uint32_t crc32(const char* data, size_t size) {
+    static const Crc32Table table;
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table.items[(crc ^ (unsigned char)data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// the dimensions of the text header are right aligned in fields of this width, so they can be rewritten in place
+static const int FieldWidth = 20;
+static const char TextHeader[] = "# name: XY\n# type: matrix\n# rows: ";
+static const char TextColumns[] = "\n# columns: ";
+static const char BinaryName[] = "XY_t";
+// first word of the manifest line naming the writer
+static const char WriterTag[] = "writer";
+
+static std::string textField(long value) {
+    char field[FieldWidth + 1];
+    std::snprintf(field, sizeof(field), "%*ld", FieldWidth, value);
+    return field;
+}
+
+struct ManifestLine {
+    long begin = 0;
+    long end = 0;
+    uint32_t crc = 0;
+    std::vector<long> counts;
+};
+
+DatasetWriter::DatasetWriter(const std::string& path, const std::string& writer, int sections, int batchSize,
+                             DatasetFormat format)
+: mPath(path), mManifestPath(path + ".manifest"), mWriter(writer), mFormat(format), mBatchSize(std::max(1, batchSize)) {
+    mFd = ::open(mPath.c_str(), O_RDWR | O_CREAT, 0644);
+    if (mFd < 0) {
+        throw DatasetException("Can't open " + mPath + " for writing.");
+    }
+    recover(sections);
+    mManifestFd = ::open(mManifestPath.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (mManifestFd < 0) {
+        throw DatasetException("Can't open " + mManifestPath + " for writing.");
+    }
+    mPending = mCommitted;
+    if (mHeader && (!updateHeader() || ::fsync(mFd) != 0)) {
+        throw DatasetException("Can't write the header of " + mPath + ".");
+    }
+    if (::lseek(mManifestFd, 0, SEEK_END) == 0) {
+        appendManifestLine(WriterTag + (" " + mWriter) + " " + std::to_string(sections));
+        // an empty first batch marks where the writer's data begins
+        appendManifest(mOffset, crc32(nullptr, 0));
+    }
+}
+
+DatasetWriter::~DatasetWriter() {
+    // a failed commit was already reported to the caller
+    if (!mFailed) {
+        try {
+            commit();
+        } catch (const DatasetException& e) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+    if (mManifestFd >= 0) {
+        ::close(mManifestFd);
+    }
+    if (mFd >= 0) {
+        ::close(mFd);
+    }
+}
+
+/**
+    Finds the last committed state and drops everything written after it.
+*/
+void DatasetWriter::recover(int sections) {
+    long fileSize = ::lseek(mFd, 0, SEEK_END);
+    mCommitted.assign(sections, 0);
+    mOffset = fileSize;
+
+    std::vector<ManifestLine> lines;
+    std::string writer;
+    int writerSections = -1;
+    std::ifstream fs(mManifestPath);
+    std::string text;
+    while (std::getline(fs, text)) {
+        // every line ends with the checksum of its text, a torn or damaged line doesn't match it
+        auto separator = text.rfind(' ');
+        if (separator == std::string::npos) {
+            continue;
+        }
+        std::istringstream tail{text.substr(separator + 1)};
+        uint32_t expected;
+        if (!(tail >> std::hex >> expected) || crc32(text.data(), separator) != expected) {
+            continue;
+        }
+        text.resize(separator);
+        std::istringstream ss{text};
+        if (text.compare(0, sizeof(WriterTag) - 1, WriterTag) == 0) {
+            std::string tag;
+            ss >> tag >> writer >> writerSections;
+            continue;
+        }
+        ManifestLine line;
+        if (!(ss >> line.begin >> line.end >> std::hex >> line.crc >> std::dec)) {
+            continue;
+        }
+        long count;
+        while (ss >> count) {
+            line.counts.push_back(count);
+        }
+        lines.push_back(line);
+    }
+    fs.close();
+    if (!lines.empty() && (fileSize == 0 || fileSize < lines.front().begin)) {
+        // the training set was removed or replaced since, the manifest describes nothing in it
+        std::cerr << "Dropped the stale manifest " << mManifestPath << "." << std::endl;
+        if (::truncate(mManifestPath.c_str(), 0) != 0) {
+            throw DatasetException("Can't reset " + mManifestPath + ".");
+        }
+        lines.clear();
+        writer.clear();
+        writerSections = -1;
+    }
+    // the counts are per section of one writer, e.g. the schedule entries of build_dataset
+    if (writerSections < 0 && !lines.empty()) {
+        writerSections = lines.back().counts.size();
+    }
+    if ((writerSections >= 0 && writerSections != sections) || (!writer.empty() && writer != mWriter)) {
+        throw DatasetException(mPath + " was written by " + (writer.empty() ? "another writer" : writer) + " with "
+                               + std::to_string(writerSections) + " section(s), " + mWriter + " can't append to it with "
+                               + std::to_string(sections) + ".");
+    }
+    if (lines.empty()) {
+        if (fileSize == 0) {
+            writeHeader();
+        } else if (mFormat == DatasetFormat::OctaveBinary || isOctaveBinary(mPath)) {
+            throw DatasetException(mPath + " isn't a training set of the requested format.");
+        }
+        // no manifest yet, keep whatever the file already has (e.g. an Octave header)
+        return;
+    }
+
+    // data before the first batch was there before the writer
+    mOffset = std::min(fileSize, lines.front().begin);
+    readHeader(mOffset);
+    for (auto it = lines.rbegin(); it != lines.rend(); ++it) {
+        if (it->begin < 0 || it->begin > it->end || it->end > fileSize) {
+            continue;
+        }
+        std::string batch(it->end - it->begin, '\0');
+        if (::pread(mFd, &batch[0], batch.size(), it->begin) != (ssize_t)batch.size()) {
+            continue;
+        }
+        if (crc32(batch.data(), batch.size()) == it->crc) {
+            mOffset = it->end;
+            std::copy(it->counts.begin(), it->counts.begin() + std::min(it->counts.size(), mCommitted.size()),
+                      mCommitted.begin());
+            break;
+        }
+    }
+
+    if (mOffset < fileSize) {
+        if (::ftruncate(mFd, mOffset) != 0 || ::fsync(mFd) != 0) {
+            throw DatasetException("Can't truncate the torn end of " + mPath + ".");
+        }
+        std::cerr << "Dropped " << (fileSize - mOffset) << " uncommitted bytes from " << mPath << "." << std::endl;
+    }
+    // a torn manifest line could swallow the next appended one
+    std::ifstream ms(mManifestPath, std::ios::binary|std::ios::ate);
+    if (ms && ms.tellg() > 0) {
+        ms.seekg(-1, std::ios::end);
+        if (ms.get() != '\n') {
+            std::ofstream(mManifestPath, std::ios::app|std::ios::out) << '\n';
+        }
+    }
+}
+
+/**
+    Finds out whether the 'size' bytes before the writer's data are its own header, and the
+    record size it holds.
+*/
+void DatasetWriter::readHeader(long size) {
+    std::string header(size, '\0');
+    if (::pread(mFd, &header[0], size, 0) != size) {
+        throw DatasetException("Can't read " + mPath + ".");
+    }
+    bool binary = (header.compare(0, 6, "Octave") == 0);
+    if (binary != (mFormat == DatasetFormat::OctaveBinary)) {
+        throw DatasetException(mPath + " isn't a training set of the requested format.");
+    }
+    if (binary) {
+        OctaveMatrixHeader fields;
+        mHeader = decodeOctaveHeader(header.data(), header.size(), fields) && fields.name == BinaryName
+                  && fields.type == OctaveType::UInt8 && (long)fields.dataOffset == size;
+        if (!mHeader) {
+            throw DatasetException(mPath + " isn't a training set of the requested format.");
+        }
+        mRecordSize = fields.rows;
+        mRowsOffset = fields.rowsOffset;
+        mColumnsOffset = fields.columnsOffset;
+        return;
+    }
+    long prefix = sizeof(TextHeader) - 1;
+    long columns = prefix + FieldWidth + sizeof(TextColumns) - 1;
+    mHeader = size == columns + FieldWidth + 1 && header.compare(0, prefix, TextHeader) == 0
+              && header.compare(prefix + FieldWidth, columns - prefix - FieldWidth, TextColumns) == 0;
+    if (mHeader) {
+        mRecordSize = std::atoi(header.c_str() + columns);
+        mRowsOffset = prefix;
+        mColumnsOffset = columns;
+    }
+}
+
+/**
+    Starts a new file with an empty matrix.
+*/
+void DatasetWriter::writeHeader() {
+    std::string header;
+    if (mFormat == DatasetFormat::OctaveBinary) {
+        OctaveMatrixHeader fields;
+        fields.name = BinaryName;
+        fields.type = OctaveType::UInt8;
+        auto bytes = encodeOctaveHeader(fields);
+        header.assign(bytes.begin(), bytes.end());
+        mRowsOffset = fields.rowsOffset;
+        mColumnsOffset = fields.columnsOffset;
+    } else {
+        header = TextHeader + textField(0);
+        mColumnsOffset = header.size() + sizeof(TextColumns) - 1;
+        header += TextColumns + textField(0) + "\n";
+        mRowsOffset = sizeof(TextHeader) - 1;
+    }
+    if (!writeSynced(mFd, header.data(), header.size())) {
+        throw DatasetException("Can't write " + mPath + ".");
+    }
+    mOffset = header.size();
+    mHeader = true;
+}
+
+/**
+    Writes the record size and the number of pending records into the header, without syncing it.
+*/
+bool DatasetWriter::updateHeader() {
+    if (!mHeader) {
+        return true;
+    }
+    long records = std::accumulate(mPending.begin(), mPending.end(), 0L);
+    if (mFormat == DatasetFormat::OctaveBinary) {
+        int32_t rows = mRecordSize;
+        int32_t columns = records;
+        return ::pwrite(mFd, &rows, sizeof(rows), mRowsOffset) == (ssize_t)sizeof(rows)
+               && ::pwrite(mFd, &columns, sizeof(columns), mColumnsOffset) == (ssize_t)sizeof(columns);
+    }
+    std::string rows = textField(records);
+    std::string columns = textField(mRecordSize);
+    return ::pwrite(mFd, rows.data(), rows.size(), mRowsOffset) == (ssize_t)rows.size()
+           && ::pwrite(mFd, columns.data(), columns.size(), mColumnsOffset) == (ssize_t)columns.size();
+}
+
+void DatasetWriter::write(int section, const std::vector<int>& queues, const std::vector<int>& annotations) {
+    if (section < 0 || section >= (int)mPending.size()) {
+        throw DatasetException("Section " + std::to_string(section) + " is out of range for the "
+                               + std::to_string(mPending.size()) + " section(s) of " + mPath + ".");
+    }
+    int size = queues.size() + annotations.size();
+    if (mRecordSize == 0) {
+        mRecordSize = size;
+    } else if (size != mRecordSize) {
+        throw DatasetException("A record of " + std::to_string(size) + " items doesn't match the "
+                               + std::to_string(mRecordSize) + " items per record of " + mPath + ".");
+    }
+    if (mFormat == DatasetFormat::OctaveBinary) {
+        auto outOfRange = [] (int item) {return item < 0 || item > 255;};
+        if (std::any_of(queues.begin(), queues.end(), outOfRange)
+            || std::any_of(annotations.begin(), annotations.end(), outOfRange)) {
+            throw DatasetException("Items of " + mPath + " have to be in [0, 255].");
+        }
+        mBuffer.append(queues.begin(), queues.end());
+        mBuffer.append(annotations.begin(), annotations.end());
+    } else {
+        std::ostringstream ss;
+        writeRecord(ss, queues, annotations);
+        mBuffer += ss.str();
+    }
+    ++mPending[section];
+    if (++mBuffered >= mBatchSize) {
+        commit();
+    }
+}
+
+void DatasetWriter::appendManifestLine(const std::string& text) {
+    std::ostringstream ss;
+    ss << text << ' ' << std::hex << crc32(text.data(), text.size()) << '\n';
+    std::string line = ss.str();
+    if (!writeSynced(mManifestFd, line.data(), line.size())) {
+        throw DatasetException("Can't write " + mManifestPath + ".");
+    }
+}
+
+void DatasetWriter::appendManifest(long begin, uint32_t crc) {
+    std::ostringstream ss;
+    ss << begin << ' ' << mOffset << ' ' << std::hex << crc << std::dec;
+    for (long count : mPending) {
+        ss << ' ' << count;
+    }
+    appendManifestLine(ss.str());
+}
+
+void DatasetWriter::commit() {
+    if (mBuffered == 0) {
+        return;
+    }
+    // cleared once the batch is committed, see ~DatasetWriter()
+    mFailed = true;
+    long begin = mOffset;
+    if (::lseek(mFd, begin, SEEK_SET) != begin
+        || !writeAll(mFd, mBuffer.data(), mBuffer.size())
+        || !updateHeader()
+        || ::fsync(mFd) != 0) {
+        throw DatasetException("Can't write " + mPath + ".");
+    }
+    mOffset += mBuffer.size();
+    appendManifest(begin, crc32(mBuffer.data(), mBuffer.size()));
+    mCommitted = mPending;
+    mBuffer.clear();
+    mBuffered = 0;
+    mFailed = false;
+}
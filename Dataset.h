@@ -0,0 +1,131 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#pragma once
+
+#include <cstdint>
+#include <exception>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+    Transforms a mathematical vector to a bool vector.
+
+    Example:
+    func([2, 3], 4) -> [0, 0, 1, 0, 0, 0, 0, 0, 1, 0]
+*/
+std::vector<int> vectorToBoolVector(const std::vector<int>& vec, int length);
+
+/**
+    Writes one training set line: the queues followed by their annotations.
+*/
+void writeRecord(std::ostream& os, const std::vector<int>& queues, const std::vector<int>& annotations);
+
+class DatasetException : public std::exception {
+private:
+    std::string m_message;
+public:
+    DatasetException(const std::string& message) : m_message(message) {
+        // empty
+    }
+
+    virtual const char* what() const noexcept {
+        return m_message.c_str();
+    }
+};
+
+/**
+    File format of DatasetWriter.
+*/
+enum class DatasetFormat {
+    // an Octave text matrix "XY", one record per line
+    Text,
+    // a uint8 matrix "XY_t" in Octave's binary format, one record per column
+    OctaveBinary
+};
+
+/**
+    Crash safe, resumable writer of training set files.
+
+    Records are buffered and written in batches. The "<path>.manifest" file starts with
+    a "writer name sections line_crc32" line, and after every batch the data is fsync-ed
+    and a line is appended (and fsync-ed) to it:
+
+    "begin end crc32 count_0 count_1 ... count_n line_crc32"
+
+    where [begin, end) is the byte range of the batch in the training set file,
+    crc32 is its checksum, count_i is the number of committed records of
+    section 'i' (e.g. a schedule entry of build_dataset) and line_crc32 is the
+    checksum of the text before it, so a torn manifest line is never read.
+
+    On open, the last manifest line whose checksums match is the committed state:
+    anything after it in the training set file is a torn write and gets truncated.
+    A manifest whose data begins past the end of the file (e.g. the file was removed)
+    is stale and starts over.
+
+    A new file starts with an Octave header whose dimensions are kept up to date on every
+    commit, so the file is loadable by Octave as it is (a text matrix, or with DatasetFormat::OctaveBinary
+    the transpose "XY_t", see readOctaveRecords()). The header is outside the checksummed batches and is
+    rewritten from the manifest on open. Existing files without a manifest (e.g. started from
+    octave_header.txt) keep their header as it is.
+*/
+class DatasetWriter {
+private:
+    std::string mPath;
+    std::string mManifestPath;
+    std::string mWriter;
+    DatasetFormat mFormat;
+    int mFd = -1;
+    int mManifestFd = -1;
+    int mBatchSize;
+    int mBuffered = 0;
+    long mOffset = 0;
+    // items per record, 0 until the first one
+    int mRecordSize = 0;
+    // whether the header is the writer's own and its dimensions have to be maintained
+    bool mHeader = false;
+    // the last commit threw, the buffered records are still pending
+    bool mFailed = false;
+    long mRowsOffset = 0;
+    long mColumnsOffset = 0;
+    std::vector<long> mCommitted;
+    std::vector<long> mPending;
+    std::string mBuffer;
+
+    void recover(int sections);
+    void readHeader(long size);
+    void writeHeader();
+    bool updateHeader();
+    void appendManifestLine(const std::string& text);
+    void appendManifest(long begin, uint32_t crc);
+public:
+    /**
+        Opens or resumes 'path' for the program 'writer' (a single word), whose records are counted
+        in 'sections' sections. Throws DatasetException if the file's manifest belongs to another
+        writer or another number of sections.
+    */
+    DatasetWriter(const std::string& path, const std::string& writer, int sections, int batchSize,
+                  DatasetFormat format = DatasetFormat::Text);
+    ~DatasetWriter();
+
+    DatasetWriter(const DatasetWriter&) = delete;
+    DatasetWriter& operator=(const DatasetWriter&) = delete;
+
+    /**
+        Number of committed records of each section.
+    */
+    const std::vector<long>& progress() const {return mCommitted;}
+
+    /**
+        Buffers a record of 'section' (0 <= section < sections). Every record of a file must have the same number of items, and with
+        DatasetFormat::OctaveBinary every item has to fit into a byte.
+    */
+    void write(int section, const std::vector<int>& queues, const std::vector<int>& annotations);
+
+    /**
+        Writes out and fsyncs the buffered records, then records them in the manifest.
+        Throws DatasetException on failure. The destructor commits what's left, unless the
+        last commit failed.
+    */
+    void commit();
+};
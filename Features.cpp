@@ -0,0 +1,94 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#include <algorithm>
+#include <limits>
+
+#include "Features.h"
+
+namespace {
+
+const int MaxResource = 255;
+
+/**
+    1 / n for every possible resource, 1 / 0 is infinity.
+*/
+struct ReciprocalTable {
+    double values[MaxResource + 1];
+
+    ReciprocalTable() {
+        values[0] = std::numeric_limits<double>::infinity();
+        for (int i = 1; i <= MaxResource; ++i) {
+            values[i] = 1. / (double)i;
+        }
+    }
+};
+
+const ReciprocalTable reciprocals;
+
+}
+
+double harmonicMean(const uint8_t* resources, int dimension) {
+    double sum = 0;
+    for (int d = 0; d < dimension; ++d) {
+        int item = resources[d];
+        if (item == 0) {
+            return 0;
+        }
+        sum += reciprocals.values[item];
+    }
+    return dimension / sum;
+}
+
+template <typename T>
+void computeFeatures(const uint8_t* samples, long sampleCount, int length, int dimension, T* features) {
+    int sampleSize = 2 * length * dimension;
+    int count = featureCount(length, dimension);
+    for (long k = 0; k < sampleCount; ++k) {
+        const uint8_t* sample = samples + k * sampleSize;
+        T* out = features + k * count;
+        for (int i = 0; i < 2 * length; ++i) {
+            out[i] = harmonicMean(sample + i * dimension, dimension);
+        }
+        std::copy(sample, sample + sampleSize, out + 2 * length);
+    }
+}
+
+template void computeFeatures<float>(const uint8_t* samples, long sampleCount, int length, int dimension, float* features);
+template void computeFeatures<double>(const uint8_t* samples, long sampleCount, int length, int dimension, double* features);
+
+FeatureExpander::FeatureExpander(int length, int dimension)
+: mLength(length), mDimension(dimension), mSample(2 * length * dimension) {
+    // empty
+}
+
+bool FeatureExpander::expand(const int* items, int count, double* row) {
+    int sampleSize = mSample.size();
+    int block = mLength + 1;
+    int labelCount = count - sampleSize;
+    if (labelCount != mLength && labelCount != mLength * block) {
+        return false;
+    }
+    for (int i = 0; i < sampleSize; ++i) {
+        if (items[i] < 0 || items[i] > MaxResource) {
+            return false;
+        }
+        mSample[i] = items[i];
+    }
+    int features = featureCount(mLength, mDimension);
+    computeFeatures(mSample.data(), 1, mLength, mDimension, row);
+
+    double* labels = row + features;
+    const int* annotation = items + sampleSize;
+    if (labelCount == mLength * block) {
+        std::copy(annotation, annotation + labelCount, labels);
+        return true;
+    }
+    std::fill(labels, labels + mLength * block, 0.);
+    for (int i = 0; i < mLength; ++i) {
+        if (annotation[i] < 0 || annotation[i] > mLength) {
+            return false;
+        }
+        labels[i * block + annotation[i]] = 1;
+    }
+    return true;
+}
@@ -0,0 +1,58 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/**
+    Harmonic mean of 'dimension' resources, 0 if any of them is 0, like mean(..., 'h') in octave/expand.m.
+
+    Uses a table of reciprocals instead of divisions.
+*/
+double harmonicMean(const uint8_t* resources, int dimension);
+
+/**
+    Number of input features of a sample: the harmonic mean of every node and job
+    followed by the raw resources (see octave/expand.m).
+*/
+inline int featureCount(int length, int dimension) {
+    return 2 * length + 2 * length * dimension;
+}
+
+/**
+    Version of the features, stored in model files (see ModelFile.h). Has to change with computeFeatures().
+*/
+const int FeatureVersion = 1;
+
+/**
+    Writes the input features of 'sampleCount' samples into 'features', featureCount() items per sample.
+
+    Implemented for float (inference) and double (training).
+*/
+template <typename T>
+void computeFeatures(const uint8_t* samples, long sampleCount, int length, int dimension, T* features);
+
+/**
+    Streaming version of octave/expand.m (with the labels expanded like octave/expandLabels.m):
+    turns training set records into rows of XY_exp, one record at a time.
+*/
+class FeatureExpander {
+private:
+    int mLength;
+    int mDimension;
+    std::vector<uint8_t> mSample;
+public:
+    FeatureExpander(int length, int dimension);
+
+    /**
+        Items of an expanded row: the features followed by the one-hot labels.
+    */
+    int columns() const {return featureCount(mLength, mDimension) + mLength * (mLength + 1);}
+
+    /**
+        Expands one record (resources followed by one-hot or compact labels, 'count' items) into
+        'row' (columns() items). Returns false if the record is malformed.
+    */
+    bool expand(const int* items, int count, double* row);
+};
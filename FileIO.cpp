@@ -0,0 +1,88 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "FileIO.h"
+
+MappedFile::MappedFile(const std::string& path, AccessPattern pattern) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) == 0) {
+        if (st.st_size == 0) {
+            mOpen = true;
+        } else {
+            void* data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                mData = static_cast<const char*>(data);
+                mSize = st.st_size;
+                mOpen = true;
+                ::madvise(data, mSize, pattern == AccessPattern::Sequential ? MADV_SEQUENTIAL : MADV_WILLNEED);
+            }
+        }
+    }
+    ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (mData) {
+        ::munmap(const_cast<char*>(mData), mSize);
+    }
+}
+
+bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+bool writeSynced(int fd, const char* data, size_t size) {
+    return writeAll(fd, data, size) && ::fsync(fd) == 0;
+}
+
+int createTempFile(const std::string& path, std::string& tempPath) {
+    std::string pattern = path + ".XXXXXX";
+    std::vector<char> name(pattern.begin(), pattern.end());
+    name.push_back('\0');
+    int fd = ::mkstemp(name.data());
+    if (fd < 0) {
+        return -1;
+    }
+    tempPath = name.data();
+    // mkstemp creates it private, the replaced file is readable like any other output
+    if (::fchmod(fd, 0644) != 0) {
+        ::close(fd);
+        ::unlink(tempPath.c_str());
+        return -1;
+    }
+    return fd;
+}
+
+bool replaceFile(int fd, const std::string& tempPath, const std::string& path) {
+    bool ok = ::fsync(fd) == 0;
+    ok = (::close(fd) == 0) && ok;
+    if (!ok || std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        ::unlink(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
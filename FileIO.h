@@ -0,0 +1,60 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/**
+    How a MappedFile is going to be read, passed on to the kernel's read ahead (madvise).
+*/
+enum class AccessPattern {
+    // front to back, once (text parsing, hashing, sidecars)
+    Sequential,
+    // repeatedly and in any order, the whole file is read ahead (model files)
+    WillNeed
+};
+
+/**
+    Read only memory mapping of a whole file.
+*/
+class MappedFile {
+private:
+    const char* mData = nullptr;
+    size_t mSize = 0;
+    bool mOpen = false;
+public:
+    explicit MappedFile(const std::string& path, AccessPattern pattern = AccessPattern::Sequential);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool isOpen() const {return mOpen;}
+    const char* data() const {return mData;}
+    size_t size() const {return mSize;}
+};
+
+/**
+    Writes 'size' bytes to 'fd', retrying short and interrupted writes. Returns false on failure.
+*/
+bool writeAll(int fd, const char* data, size_t size);
+
+/**
+    writeAll() followed by an fsync, the data is durable once it returns true.
+*/
+bool writeSynced(int fd, const char* data, size_t size);
+
+/**
+    Creates a new file with a unique name next to 'path' ("<path>.XXXXXX", see mkstemp), for
+    writing a replacement of 'path' that doesn't collide with another process doing the same.
+    Sets 'tempPath' and returns the open descriptor, or -1 on failure.
+*/
+int createTempFile(const std::string& path, std::string& tempPath);
+
+/**
+    Fsyncs and closes 'fd', a file written at 'tempPath', and renames it to 'path', so readers
+    see either the old or the complete new file. The temporary file is removed on failure.
+    'tempPath' comes from createTempFile().
+*/
+bool replaceFile(int fd, const std::string& tempPath, const std::string& path);
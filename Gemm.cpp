@@ -0,0 +1,64 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#include <algorithm>
+
+#include "Gemm.h"
+
+namespace {
+
+// register block: rows of 'a' x columns of 'b'
+const int RowBlock = 4;
+const int ColumnBlock = 32;
+
+/**
+    c (m x n) = a (m x k) * b (k x n), or c += a * b if 'accumulate'.
+
+    A k x ColumnBlock panel of 'b' stays in L1 while every block of RowBlock rows of 'a' passes over it.
+    The innermost loop is a contiguous multiply-add over the columns, so it vectorizes.
+*/
+void gemm(const double* a, const double* b, double* c, int m, int k, int n, bool accumulate) {
+    for (int j0 = 0; j0 < n; j0 += ColumnBlock) {
+        int columns = std::min(ColumnBlock, n - j0);
+        for (int i0 = 0; i0 < m; i0 += RowBlock) {
+            int rows = std::min(RowBlock, m - i0);
+            double acc[RowBlock][ColumnBlock] = {};
+            for (int p = 0; p < k; ++p) {
+                const double* panel = b + (size_t)p * n + j0;
+                for (int i = 0; i < rows; ++i) {
+                    double x = a[(size_t)(i0 + i) * k + p];
+                    double* row = acc[i];
+                    for (int j = 0; j < columns; ++j) {
+                        row[j] += x * panel[j];
+                    }
+                }
+            }
+            for (int i = 0; i < rows; ++i) {
+                double* out = c + (size_t)(i0 + i) * n + j0;
+                for (int j = 0; j < columns; ++j) {
+                    out[j] = accumulate ? out[j] + acc[i][j] : acc[i][j];
+                }
+            }
+        }
+    }
+}
+
+}
+
+void multiply(const double* a, const double* b, double* c, int m, int k, int n) {
+    gemm(a, b, c, m, k, n, false);
+}
+
+void accumulateTransposed(const double* a, const double* b, double* c, int k, int m, int n,
+                          std::vector<double>& scratch) {
+    scratch.resize((size_t)m * k);
+    transpose(a, scratch.data(), k, m);
+    gemm(scratch.data(), b, c, m, k, n, true);
+}
+
+void transpose(const double* a, double* t, int m, int n) {
+    for (int i = 0; i < m; ++i) {
+        for (int j = 0; j < n; ++j) {
+            t[(size_t)j * m + i] = a[(size_t)i * n + j];
+        }
+    }
+}
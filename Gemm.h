@@ -0,0 +1,28 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#pragma once
+
+#include <vector>
+
+/**
+    Double precision matrix products of the trainer. All matrices are dense and row major.
+*/
+
+/**
+    c (m x n) = a (m x k) * b (k x n)
+*/
+void multiply(const double* a, const double* b, double* c, int m, int k, int n);
+
+/**
+    c (m x n) += a' * b, where a is k x m and b is k x n.
+
+    Used for gradients, 'k' runs over the samples of a batch. 'a' is transposed into 'scratch' first,
+    so the product runs on the register blocked kernel of multiply().
+*/
+void accumulateTransposed(const double* a, const double* b, double* c, int k, int m, int n,
+                          std::vector<double>& scratch);
+
+/**
+    Writes the transpose of 'a' (m x n) into 't' (n x m).
+*/
+void transpose(const double* a, double* t, int m, int n);
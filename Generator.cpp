@@ -0,0 +1,39 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#include <algorithm>
+
+#include "Generator.h"
+
+/**
+    Returns a random distribution that marks the place of
+    empty and real elements.
+*/
+std::vector<bool> Generator::randomizedNullItems(double ratio) {
+    std::vector<bool> items(2 * mLength);
+    int nullItems = ratio * 2 * mLength;
+    for (int i = 0; i < nullItems; ++i) {
+        items[i] = 1;
+    }
+    std::shuffle(items.begin(), items.end(), mEngine);
+    return items;
+}
+
+std::vector<int> Generator::generate(double ratio) {
+    auto nullItemDistribution = randomizedNullItems(ratio);
+    std::uniform_int_distribution<int> dist(1, 100);
+
+    std::vector<int> ret;
+    ret.reserve(2 * mLength * mDimension);
+    for (int i = 0; i < 2 * mLength; ++i) {
+        if (nullItemDistribution[i]) {
+            for (int d = 0; d < mDimension; ++d) {
+                ret.push_back(0);
+            }
+        } else {
+            for (int d = 0; d < mDimension; ++d) {
+                ret.push_back(dist(mEngine));
+            }
+        }
+    }
+    return ret;
+}
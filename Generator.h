@@ -0,0 +1,37 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#pragma once
+
+#include <vector>
+#include <random>
+
+/**
+    Random generator of node and job queues.
+
+    Keeps its own random engine, so consecutive calls (or several
+    generators living in different threads) never share a seed.
+*/
+class Generator {
+private:
+    int mLength;
+    int mDimension;
+    std::mt19937 mEngine;
+
+    std::vector<bool> randomizedNullItems(double ratio);
+public:
+    Generator(int length, int dimension, unsigned seed)
+    : mLength(length), mDimension(dimension), mEngine(seed) {
+        // empty
+    }
+    /**
+        Returns a random vector of integers whose elements are between 1 and 100.
+
+        The hidden structure is the following:
+        - Two consecutive 'length' number of tuples of 'dimension' number of items.
+        - First tuple array represents the node resources.
+        - Second tupple array represents the job resources.
+
+        'ratio' amount of the nodes and jobs are replaced with empty (all 0) items.
+    */
+    std::vector<int> generate(double ratio);
+};
@@ -0,0 +1,130 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#include <algorithm>
+
+#include "Features.h"
+#include "Heuristics.h"
+
+/**
+    Sort key of every job, computed once per sample.
+*/
+static void computeKeys(const uint8_t* sample, int length, int dimension, SortKey key, std::vector<double>& keys) {
+    const uint8_t* jobs = sample + length * dimension;
+    if (key == SortKey::HarmonicMean) {
+        for (int i = 0; i < length; ++i) {
+            keys[i] = harmonicMean(jobs + i * dimension, dimension);
+        }
+        return;
+    }
+    for (int d = 0; d < dimension; ++d) {
+        double total = 0;
+        if (key == SortKey::DotProduct) {
+            for (int n = 0; n < length; ++n) {
+                total += sample[n * dimension + d];
+            }
+        }
+        for (int i = 0; i < length; ++i) {
+            double item = jobs[i * dimension + d];
+            switch (key) {
+            case SortKey::DotProduct:
+                keys[i] += item * total;
+                break;
+            case SortKey::L2:
+                // the square keeps the order
+                keys[i] += item * item;
+                break;
+            case SortKey::MaxDimension:
+                keys[i] = std::max(keys[i], item);
+                break;
+            case SortKey::Online:
+            case SortKey::HarmonicMean:
+                break;
+            }
+        }
+    }
+}
+
+void sortJobs(const uint8_t* sample, int length, int dimension, SortKey key, HeuristicScratch& scratch) {
+    auto& order = scratch.order;
+    order.resize(length);
+    for (int i = 0; i < length; ++i) {
+        order[i] = i;
+    }
+    if (key == SortKey::Online) {
+        return;
+    }
+
+    auto& keys = scratch.keys;
+    keys.assign(length, 0);
+    computeKeys(sample, length, dimension, key, keys);
+    // stable insertion sort, queues are short and it doesn't allocate
+    for (int i = 1; i < length; ++i) {
+        int job = order[i];
+        int j = i;
+        for (; j > 0 && keys[order[j - 1]] < keys[job]; --j) {
+            order[j] = order[j - 1];
+        }
+        order[j] = job;
+    }
+}
+
+void Heuristic::place(const uint8_t* sample, int length, int dimension, uint8_t* assignment, HeuristicScratch& scratch) const {
+    sortJobs(sample, length, dimension, mKey, scratch);
+    auto& resources = scratch.resources;
+    resources.assign(sample, sample + length * dimension);
+    const uint8_t* jobs = sample + length * dimension;
+    int current = 0;
+
+    for (int i : scratch.order) {
+        const uint8_t* job = jobs + i * dimension;
+        int chosen = -1;
+        int64_t chosenSlack = 0;
+        int first = (mPolicy == FitPolicy::NextFit) ? current : 0;
+        for (int n = first; n < length; ++n) {
+            const int* node = resources.data() + n * dimension;
+            int64_t slack = 0;
+            bool fits = true;
+            for (int d = 0; d < dimension; ++d) {
+                int left = node[d] - job[d];
+                fits = fits && left >= 0;
+                slack += left;
+            }
+            if (!fits) {
+                continue;
+            }
+            if (mPolicy == FitPolicy::FirstFit || mPolicy == FitPolicy::NextFit) {
+                chosen = n;
+                break;
+            }
+            bool better = (mPolicy == FitPolicy::BestFit) ? slack < chosenSlack : slack > chosenSlack;
+            if (chosen < 0 || better) {
+                chosen = n;
+                chosenSlack = slack;
+            }
+        }
+        if (chosen < 0) {
+            assignment[i] = 0;
+            continue;
+        }
+        for (int d = 0; d < dimension; ++d) {
+            resources[chosen * dimension + d] -= job[d];
+        }
+        assignment[i] = chosen + 1;
+        current = chosen;
+    }
+}
+
+std::vector<Heuristic> allHeuristics() {
+    std::vector<Heuristic> ret;
+    ret.push_back(Heuristic("First Fit (online)", FitPolicy::FirstFit, SortKey::Online));
+    ret.push_back(Heuristic("Best Fit (online)", FitPolicy::BestFit, SortKey::Online));
+    ret.push_back(Heuristic("Worst Fit (online)", FitPolicy::WorstFit, SortKey::Online));
+    ret.push_back(Heuristic("Next Fit (online)", FitPolicy::NextFit, SortKey::Online));
+    ret.push_back(Heuristic("FFD dot product", FitPolicy::FirstFit, SortKey::DotProduct));
+    ret.push_back(Heuristic("FFD L2", FitPolicy::FirstFit, SortKey::L2));
+    ret.push_back(Heuristic("FFD max dimension", FitPolicy::FirstFit, SortKey::MaxDimension));
+    ret.push_back(Heuristic("BFD dot product", FitPolicy::BestFit, SortKey::DotProduct));
+    ret.push_back(Heuristic("BFD L2", FitPolicy::BestFit, SortKey::L2));
+    ret.push_back(Heuristic("BFD max dimension", FitPolicy::BestFit, SortKey::MaxDimension));
+    return ret;
+}
@@ -0,0 +1,85 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+    Node selection rule of a heuristic.
+*/
+enum class FitPolicy {
+    // first node with enough resources
+    FirstFit,
+    // node with the least resources left after the placement
+    BestFit,
+    // node with the most resources left after the placement
+    WorstFit,
+    // the current node, or the next one with enough resources (never looks back)
+    NextFit
+};
+
+/**
+    Job order of a heuristic. Online heuristics keep the arrival order,
+    offline (decreasing) ones place the biggest jobs first.
+*/
+enum class SortKey {
+    // arrival order
+    Online,
+    // dot product of the job and the total node resources
+    DotProduct,
+    // euclidean length of the job
+    L2,
+    // biggest resource of the job
+    MaxDimension,
+    // harmonic mean of the resources of the job (0 if any of them is 0)
+    HarmonicMean
+};
+
+/**
+    Reusable buffers of Heuristic::place(), so placing doesn't allocate.
+*/
+struct HeuristicScratch {
+    std::vector<int> resources;
+    std::vector<int> order;
+    std::vector<double> keys;
+};
+
+/**
+    Writes the placement order of the jobs of 'sample' by 'key' into 'scratch.order', biggest first.
+
+    The sort is stable, jobs with equal keys keep their arrival order.
+*/
+void sortJobs(const uint8_t* sample, int length, int dimension, SortKey key, HeuristicScratch& scratch);
+
+/**
+    Online and offline bin packing heuristics behind one interface.
+
+    Samples are flat arrays in the training set layout, one byte per resource:
+    'length' nodes of 'dimension' resources followed by 'length' jobs.
+*/
+class Heuristic {
+private:
+    std::string mName;
+    FitPolicy mPolicy;
+    SortKey mKey;
+public:
+    Heuristic(const std::string& name, FitPolicy policy, SortKey key)
+    : mName(name), mPolicy(policy), mKey(key) {
+        // empty
+    }
+
+    const std::string& name() const {return mName;}
+
+    /**
+        Writes the assigned node of every job into 'assignment' (0 means unassigned, 'n' is the n-th node).
+    */
+    void place(const uint8_t* sample, int length, int dimension, uint8_t* assignment, HeuristicScratch& scratch) const;
+};
+
+/**
+    Online First/Best/Worst/Next Fit and First/Best Fit Decreasing with the
+    dot product, L2 and max dimension sort keys.
+*/
+std::vector<Heuristic> allHeuristics();
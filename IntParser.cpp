@@ -0,0 +1,242 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+#include "IntParser.h"
+
+static inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/**
+    Returns the number of leading decimal digits in the 8 bytes of 'word' (8 if all are digits).
+
+    A byte is a digit if its high nibble is 3 and it stays so after adding 6.
+    ASCII bytes are below 0x80, so adding 6 never carries into the next byte.
+*/
+static inline int digitCount(uint64_t word) {
+    const uint64_t high = 0xF0F0F0F0F0F0F0F0ULL;
+    const uint64_t zeros = 0x3030303030303030ULL;
+    uint64_t nonDigits = ((word & high) ^ zeros) | (((word + 0x0606060606060606ULL) & high) ^ zeros);
+    if (nonDigits == 0) {
+        return 8;
+    }
+    return __builtin_ctzll(nonDigits) >> 3;
+}
+
+/**
+    Converts the first 'count' (1..8) ASCII digits in the little endian 'word' to their value.
+
+    The digits are moved to the top bytes (the missing ones become leading zeros),
+    then pairs, quads and octets are combined with three multiplications.
+*/
+static inline uint32_t digitsValue(uint64_t word, int count) {
+    word -= 0x3030303030303030ULL;
+    word <<= 8 * (8 - count);
+    word = (word * 10) + (word >> 8);
+    word = (((word & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32)))
+            + (((word >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+    return (uint32_t)word;
+}
+
+/**
+    Parses the integer at 'p'. Returns the position after it, or 'p' if there is no integer
+    or it doesn't fit into an int.
+*/
+static inline const char* parseInt(const char* p, const char* end, int& value) {
+    const char* origin = p;
+    bool negative = false;
+    if (p < end && *p == '-') {
+        negative = true;
+        ++p;
+    }
+    const char* start = p;
+    int64_t v = 0;
+    if (end - p >= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, 8);
+        int count = digitCount(word);
+        if (count == 0) {
+            return origin;
+        }
+        if (count < 8) {
+            v = digitsValue(word, count);
+            value = negative ? -(int)v : (int)v;
+            return p + count;
+        }
+    }
+    // long numbers and the tail of the file, v stays far from overflowing int64_t
+    while (p < end && (unsigned)(*p - '0') < 10) {
+        v = v * 10 + (*p - '0');
+        if (v > std::numeric_limits<int>::max()) {
+            return origin;
+        }
+        ++p;
+    }
+    if (p == start) {
+        return origin;
+    }
+    value = negative ? -(int)v : (int)v;
+    return p;
+}
+
+static inline bool isDataLine(const char* p, const char* lineEnd) {
+    while (p < lineEnd && isSpace(*p)) {
+        ++p;
+    }
+    return p < lineEnd && *p != '#';
+}
+
+static inline const char* lineEnd(const char* p, const char* end) {
+    const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return nl ? nl : end;
+}
+
+/**
+    Parses one line into 'out' (at most 'columns' items). Returns the number of integers on the line,
+    or -1 if it has anything else or a value which doesn't fit into T.
+*/
+template <typename T>
+static int parseLine(const char* p, const char* end, T* out, int columns) {
+    int count = 0;
+    int value = 0;
+    for (;;) {
+        while (p < end && isSpace(*p)) {
+            ++p;
+        }
+        if (p == end) {
+            return count;
+        }
+        const char* next = parseInt(p, end, value);
+        if (next == p || (next < end && !isSpace(*next))) {
+            // not a number
+            return -1;
+        }
+        if (value < std::numeric_limits<T>::min() || value > std::numeric_limits<T>::max()) {
+            return -1;
+        }
+        if (count < columns) {
+            out[count] = value;
+        }
+        ++count;
+        p = next;
+    }
+}
+
+bool parseIntLine(const char* p, const char* end, std::vector<int>& items) {
+    items.clear();
+    int value = 0;
+    for (;;) {
+        while (p < end && isSpace(*p)) {
+            ++p;
+        }
+        if (p == end) {
+            return true;
+        }
+        const char* next = parseInt(p, end, value);
+        if (next == p || (next < end && !isSpace(*next))) {
+            return false;
+        }
+        items.push_back(value);
+        p = next;
+    }
+}
+
+template <typename T>
+bool parseIntMatrix(const std::string& path, int threads, Matrix<T>& matrix) {
+    matrix = Matrix<T>();
+    MappedFile file(path);
+    if (!file.isOpen()) {
+        return false;
+    }
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+    if (file.size() == 0) {
+        return true;
+    }
+
+    // the first data line defines the number of columns
+    for (const char* p = begin; p < end; p = lineEnd(p, end) + 1) {
+        const char* e = lineEnd(p, end);
+        if (isDataLine(p, e)) {
+            matrix.columns = std::max(0, parseLine<T>(p, e, nullptr, 0));
+            break;
+        }
+    }
+
+    // line aligned chunks
+    threads = std::max(1, threads);
+    std::vector<const char*> bounds;
+    bounds.push_back(begin);
+    for (int t = 1; t < threads; ++t) {
+        const char* p = begin + file.size() * t / threads;
+        p = std::max(p, bounds.back());
+        p = (p < end) ? lineEnd(p, end) + 1 : end;
+        bounds.push_back(std::min(p, end));
+    }
+    bounds.push_back(end);
+    int chunks = bounds.size() - 1;
+
+    // first pass: data lines per chunk
+    std::vector<long> rows(chunks + 1, 0);
+    std::vector<std::thread> workers;
+    for (int c = 0; c < chunks; ++c) {
+        workers.emplace_back([&bounds, &rows, c] () {
+            long count = 0;
+            const char* chunkEnd = bounds[c + 1];
+            for (const char* p = bounds[c]; p < chunkEnd; ) {
+                const char* e = lineEnd(p, chunkEnd);
+                count += isDataLine(p, e);
+                p = e + 1;
+            }
+            rows[c + 1] = count;
+        });
+    }
+    for (auto& t : workers) {
+        t.join();
+    }
+    workers.clear();
+    for (int c = 0; c < chunks; ++c) {
+        rows[c + 1] += rows[c];
+    }
+    matrix.rows = rows[chunks];
+    matrix.items.resize((size_t)matrix.rows * matrix.columns);
+
+    // second pass: parse every chunk into its rows
+    std::vector<std::vector<ParseError>> errors(chunks);
+    for (int c = 0; c < chunks; ++c) {
+        workers.emplace_back([&bounds, &rows, &errors, &matrix, begin, c] () {
+            int columns = matrix.columns;
+            T* out = matrix.items.data() + (size_t)rows[c] * columns;
+            const char* chunkEnd = bounds[c + 1];
+            for (const char* p = bounds[c]; p < chunkEnd; ) {
+                const char* e = lineEnd(p, chunkEnd);
+                if (isDataLine(p, e)) {
+                    int count = parseLine(p, e, out, columns);
+                    if (count != columns) {
+                        ParseError error;
+                        error.offset = p - begin;
+                        error.items = count;
+                        errors[c].push_back(error);
+                    }
+                    out += columns;
+                }
+                p = e + 1;
+            }
+        });
+    }
+    for (auto& t : workers) {
+        t.join();
+    }
+    for (const auto& chunkErrors : errors) {
+        matrix.errors.insert(matrix.errors.end(), chunkErrors.begin(), chunkErrors.end());
+    }
+    return true;
+}
+
+template bool parseIntMatrix<int>(const std::string& path, int threads, IntMatrix& matrix);
+template bool parseIntMatrix<uint8_t>(const std::string& path, int threads, ByteMatrix& matrix);
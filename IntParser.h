@@ -0,0 +1,57 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "FileIO.h"
+
+/**
+    A line that didn't have the expected number of integers.
+*/
+struct ParseError {
+    // byte offset of the start of the line
+    size_t offset = 0;
+    int items = 0;
+};
+
+/**
+    Integer matrix read from a whitespace separated text file.
+*/
+template <typename T>
+struct Matrix {
+    // rows * columns items, row major
+    std::vector<T> items;
+    long rows = 0;
+    int columns = 0;
+    // the content of the rows of malformed lines is unspecified
+    std::vector<ParseError> errors;
+};
+
+typedef Matrix<int> IntMatrix;
+// for files of small non-negative integers, a quarter of the memory of IntMatrix
+typedef Matrix<uint8_t> ByteMatrix;
+
+/**
+    Parses one line of whitespace separated integers into 'items'.
+
+    Returns false if the line has anything else than integers.
+*/
+bool parseIntLine(const char* begin, const char* end, std::vector<int>& items);
+
+/**
+    Parses a text file of integers, one matrix row per line.
+
+    The number of columns is taken from the first line. Empty lines and lines starting
+    with '#' (Octave headers) are skipped. The file is memory mapped, split into line
+    aligned chunks and parsed by 'threads' threads straight into the result.
+
+    Values that don't fit into T make their line malformed.
+
+    Returns false if the file can't be read. Implemented for IntMatrix and ByteMatrix.
+*/
+template <typename T>
+bool parseIntMatrix(const std::string& path, int threads, Matrix<T>& matrix);
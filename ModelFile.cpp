@@ -0,0 +1,140 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <unistd.h>
+
+#include "FileIO.h"
+#include "ModelFile.h"
+
+namespace {
+
+const char Magic[8] = {'B', 'P', 'N', 'N', 'M', 'O', 'D', 'L'};
+// reads back as another value on a machine of the other byte order
+const uint32_t ByteOrderMark = 0x01020304;
+const uint32_t MaxSection = 255;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    ModelShape shape;
+    uint32_t sections;
+    uint32_t reserved;
+};
+
+struct SectionEntry {
+    uint32_t kind;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+};
+
+size_t align(size_t offset) {
+    return (offset + ModelFile::Alignment - 1) / ModelFile::Alignment * ModelFile::Alignment;
+}
+
+}
+
+ModelFile::ModelFile(const std::string& path) : mFile(path, AccessPattern::WillNeed), mPath(path) {
+    if (!mFile.isOpen()) {
+        throw ModelException("Can't open " + path + ".");
+    }
+    Header header;
+    if (mFile.size() < sizeof(header)) {
+        throw ModelException(path + " isn't a model file.");
+    }
+    std::memcpy(&header, mFile.data(), sizeof(header));
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0) {
+        throw ModelException(path + " isn't a model file.");
+    }
+    if (header.byteOrder != ByteOrderMark) {
+        throw ModelException(path + " was written on a machine of the other byte order.");
+    }
+    if (header.version != Version) {
+        throw ModelException(path + " is a model file of version " + std::to_string(header.version)
+                             + ", expected " + std::to_string(Version) + ".");
+    }
+    size_t end = sizeof(header) + (size_t)header.sections * sizeof(SectionEntry);
+    if (end > mFile.size()) {
+        throw ModelException(path + " is truncated.");
+    }
+    mShape = header.shape;
+    const char* entries = mFile.data() + sizeof(header);
+    for (uint32_t s = 0; s < header.sections; ++s) {
+        SectionEntry entry;
+        std::memcpy(&entry, entries + s * sizeof(entry), sizeof(entry));
+        if (entry.offset % Alignment != 0 || entry.offset > mFile.size() || entry.size > mFile.size() - entry.offset) {
+            throw ModelException(path + " is truncated.");
+        }
+        if (entry.kind > MaxSection) {
+            // added by a later version, not needed by this one
+            continue;
+        }
+        if (entry.kind >= mSections.size()) {
+            mSections.resize(entry.kind + 1, nullptr);
+            mSizes.resize(entry.kind + 1, 0);
+        }
+        mSections[entry.kind] = mFile.data() + entry.offset;
+        mSizes[entry.kind] = entry.size;
+    }
+}
+
+bool ModelFile::has(ModelSection section) const {
+    size_t kind = (size_t)section;
+    return kind < mSections.size() && mSections[kind] != nullptr;
+}
+
+const char* ModelFile::find(ModelSection section, size_t size) const {
+    if (!has(section)) {
+        throw ModelException("Section " + std::to_string((uint32_t)section) + " is missing from " + mPath + ".");
+    }
+    if (mSizes[(size_t)section] != size) {
+        throw ModelException("Section " + std::to_string((uint32_t)section) + " of " + mPath
+                             + " doesn't match the network's dimensions.");
+    }
+    return mSections[(size_t)section];
+}
+
+bool isModelFile(const std::string& path) {
+    char magic[sizeof(Magic)];
+    std::ifstream fs(path, std::ios::binary);
+    return fs.read(magic, sizeof(magic)) && std::memcmp(magic, Magic, sizeof(Magic)) == 0;
+}
+
+void ModelFileWriter::commit(const std::string& path) const {
+    Header header = Header();
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = ModelFile::Version;
+    header.byteOrder = ByteOrderMark;
+    header.shape = mShape;
+    header.sections = mArrays.size();
+
+    std::vector<char> file(align(sizeof(header) + mArrays.size() * sizeof(SectionEntry)), 0);
+    std::memcpy(file.data(), &header, sizeof(header));
+    for (size_t s = 0; s < mArrays.size(); ++s) {
+        SectionEntry entry = SectionEntry();
+        entry.kind = (uint32_t)mKinds[s];
+        entry.offset = file.size();
+        entry.size = mArrays[s].size();
+        std::memcpy(file.data() + sizeof(header) + s * sizeof(entry), &entry, sizeof(entry));
+        file.insert(file.end(), mArrays[s].begin(), mArrays[s].end());
+        file.resize(align(file.size()), 0);
+    }
+
+    std::string tempPath;
+    int fd = createTempFile(path, tempPath);
+    if (fd < 0) {
+        throw ModelException("Can't write " + path + ".");
+    }
+    if (!writeAll(fd, file.data(), file.size())) {
+        ::close(fd);
+        ::unlink(tempPath.c_str());
+        throw ModelException("Can't write " + path + ".");
+    }
+    if (!replaceFile(fd, tempPath, path)) {
+        throw ModelException("Can't write " + path + ".");
+    }
+}
@@ -0,0 +1,141 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include "FileIO.h"
+
+class ModelException : public std::exception {
+private:
+    std::string m_message;
+public:
+    ModelException(const std::string& message) : m_message(message) {
+        // empty
+    }
+
+    virtual const char* what() const noexcept {
+        return m_message.c_str();
+    }
+};
+
+/**
+    Arrays of a model file, see ModelFile.
+*/
+enum class ModelSection : uint32_t {
+    // inputs x hidden floats, Network::weights1()
+    Weights1 = 1,
+    // hidden floats
+    Bias1 = 2,
+    // hidden x outputs floats, Network::weights2()
+    Weights2 = 3,
+    // outputs floats
+    Bias2 = 4,
+    // hidden x inputs int8 rows of QuantizedNetwork, one float scale per row
+    QuantizedWeights1 = 5,
+    Scale1 = 6,
+    // outputs x hidden int8 rows of QuantizedNetwork, one float scale per row
+    QuantizedWeights2 = 7,
+    Scale2 = 8
+};
+
+/**
+    Dimensions of the network of a model file.
+*/
+struct ModelShape {
+    int32_t length = 0;
+    int32_t dimension = 0;
+    int32_t inputs = 0;
+    int32_t hidden = 0;
+    int32_t outputs = 0;
+    // version of the input features (Features.h) the network was trained on
+    int32_t features = 0;
+};
+
+/**
+    Read only, memory mapped model file.
+
+    Layout (native byte order, checked on open):
+
+        header       magic "BPNNMODL", version, byte order mark, ModelShape, section count
+        sections     one (kind, offset, size) entry per array
+        arrays       every array starts at a multiple of Alignment bytes
+
+    Arrays are used in place, so opening a model costs a mapping and a few checks, and every
+    process that opens the same file shares its pages. Files are written by ModelFileWriter
+    and replaced by renaming, a mapped file keeps its old content.
+*/
+class ModelFile {
+private:
+    MappedFile mFile;
+    std::string mPath;
+    ModelShape mShape;
+    std::vector<const char*> mSections;
+    std::vector<size_t> mSizes;
+public:
+    static const uint32_t Version = 1;
+    static const size_t Alignment = 64;
+
+    /**
+        Maps 'path', throws ModelException if it isn't a valid model file of this version.
+    */
+    explicit ModelFile(const std::string& path);
+
+    ModelFile(const ModelFile&) = delete;
+    ModelFile& operator=(const ModelFile&) = delete;
+
+    const std::string& path() const {return mPath;}
+    const ModelShape& shape() const {return mShape;}
+
+    /**
+        Whether the file has the section.
+    */
+    bool has(ModelSection section) const;
+
+    /**
+        The array of 'section', which has to hold 'count' items of T.
+        Throws ModelException if it's missing or has a different size.
+    */
+    template <typename T>
+    const T* get(ModelSection section, size_t count) const {
+        return reinterpret_cast<const T*>(find(section, count * sizeof(T)));
+    }
+
+    const char* find(ModelSection section, size_t size) const;
+};
+
+/**
+    Whether the file starts with the magic of a model file.
+*/
+bool isModelFile(const std::string& path);
+
+/**
+    Collects the arrays of a model and writes them as a model file.
+*/
+class ModelFileWriter {
+private:
+    ModelShape mShape;
+    std::vector<ModelSection> mKinds;
+    std::vector<std::vector<char>> mArrays;
+public:
+    explicit ModelFileWriter(const ModelShape& shape) : mShape(shape) {
+        // empty
+    }
+
+    template <typename T>
+    void add(ModelSection section, const T* items, size_t count) {
+        const char* bytes = reinterpret_cast<const char*>(items);
+        mKinds.push_back(section);
+        mArrays.emplace_back(bytes, bytes + count * sizeof(T));
+    }
+
+    /**
+        Writes the file next to 'path', fsyncs it and renames it into place, so readers see
+        either the old or the new model. Throws ModelException on failure.
+    */
+    void commit(const std::string& path) const;
+};
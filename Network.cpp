@@ -0,0 +1,687 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include <sys/stat.h>
+
+#include "Features.h"
+#include "Network.h"
+
+namespace {
+
+// samples per forward pass, the hidden activations of a batch stay in L2
+const int BatchSize = 64;
+// GEMM register block: rows of the input x columns of the output
+const int RowBlock = 4;
+const int ColumnBlock = 64;
+// samples with at most this fraction of nonzero features take the sparse first layer; a fully
+// dense row costs sparseRow() about 1.6 times what it costs gemm(), the two break even near 0.62
+const float SparseDensity = 0.6f;
+// accumulators of sparseRow(), they stay in registers
+const int SparseColumns = 16;
+
+/**
+    c (m x n) = bias + a (m x k) * w (k x n), all row major.
+
+    A k x ColumnBlock panel of 'w' stays in L1 while every block of RowBlock rows of 'a' passes over it.
+    The innermost loop is a contiguous multiply-add over the columns, so it vectorizes.
+*/
+void gemm(const float* a, int m, int k, const float* w, const float* bias, int n, float* c) {
+    for (int j0 = 0; j0 < n; j0 += ColumnBlock) {
+        int columns = std::min(ColumnBlock, n - j0);
+        for (int i0 = 0; i0 < m; i0 += RowBlock) {
+            int rows = std::min(RowBlock, m - i0);
+            float acc[RowBlock][ColumnBlock];
+            for (int i = 0; i < rows; ++i) {
+                std::copy(bias + j0, bias + j0 + columns, acc[i]);
+            }
+            for (int p = 0; p < k; ++p) {
+                const float* panel = w + (size_t)p * n + j0;
+                for (int i = 0; i < rows; ++i) {
+                    float x = a[(size_t)(i0 + i) * k + p];
+                    float* row = acc[i];
+                    for (int j = 0; j < columns; ++j) {
+                        row[j] += x * panel[j];
+                    }
+                }
+            }
+            for (int i = 0; i < rows; ++i) {
+                std::copy(acc[i], acc[i] + columns, c + (size_t)(i0 + i) * n + j0);
+            }
+        }
+    }
+}
+
+/**
+    c (1 x n) = bias + a (1 x k) * w (k x n), where only the 'count' items of 'a' at 'nonzeros' are nonzero.
+
+    Every nonzero item adds its row of 'w' to SparseColumns accumulators at a time, so the cost is
+    proportional to the nonzero items. The products are summed in the same order as by gemm(),
+    which only adds zeros besides, so the result is the same.
+*/
+void sparseRow(const float* a, const int* nonzeros, int count, const float* w, const float* bias, int n, float* c) {
+    int j0 = 0;
+    for (; j0 + SparseColumns <= n; j0 += SparseColumns) {
+        float acc[SparseColumns];
+        for (int j = 0; j < SparseColumns; ++j) {
+            acc[j] = bias[j0 + j];
+        }
+        for (int t = 0; t < count; ++t) {
+            float x = a[nonzeros[t]];
+            const float* panel = w + (size_t)nonzeros[t] * n + j0;
+            for (int j = 0; j < SparseColumns; ++j) {
+                acc[j] += x * panel[j];
+            }
+        }
+        for (int j = 0; j < SparseColumns; ++j) {
+            c[j0 + j] = acc[j];
+        }
+    }
+    for (int j = j0; j < n; ++j) {
+        float acc = bias[j];
+        for (int t = 0; t < count; ++t) {
+            acc += a[nonzeros[t]] * w[(size_t)nonzeros[t] * n + j];
+        }
+        c[j] = acc;
+    }
+}
+
+/**
+    Indices of the nonzero items of 'a' (k items) into 'nonzeros', returns their number.
+*/
+int findNonzeros(const float* a, int k, int* nonzeros) {
+    int count = 0;
+    for (int p = 0; p < k; ++p) {
+        nonzeros[count] = p;
+        count += (a[p] != 0);
+    }
+    return count;
+}
+
+/**
+    The first layer, gemm() for a batch of feature rows whose blank nodes and jobs are zeros.
+
+    Samples with mostly blank slots go through sparseRow() one by one, the rest are gathered
+    into one dense gemm(). Both give the same sums.
+*/
+void firstLayer(const float* a, int m, int k, const float* w, const float* bias, int n, float* c,
+                NetworkScratch& scratch) {
+    scratch.nonzeros.resize(k);
+    scratch.denseRows.clear();
+    for (int i = 0; i < m; ++i) {
+        const float* row = a + (size_t)i * k;
+        int count = findNonzeros(row, k, scratch.nonzeros.data());
+        if (count <= SparseDensity * k) {
+            sparseRow(row, scratch.nonzeros.data(), count, w, bias, n, c + (size_t)i * n);
+        } else {
+            scratch.denseRows.push_back(i);
+        }
+    }
+    int dense = scratch.denseRows.size();
+    if (dense == m) {
+        gemm(a, m, k, w, bias, n, c);
+        return;
+    }
+    if (dense == 0) {
+        return;
+    }
+    scratch.denseFeatures.resize((size_t)dense * k);
+    scratch.denseHidden.resize((size_t)dense * n);
+    for (int r = 0; r < dense; ++r) {
+        const float* row = a + (size_t)scratch.denseRows[r] * k;
+        std::copy(row, row + k, scratch.denseFeatures.begin() + (size_t)r * k);
+    }
+    gemm(scratch.denseFeatures.data(), dense, k, w, bias, n, scratch.denseHidden.data());
+    for (int r = 0; r < dense; ++r) {
+        auto row = scratch.denseHidden.begin() + (size_t)r * n;
+        std::copy(row, row + n, c + (size_t)scratch.denseRows[r] * n);
+    }
+}
+
+/**
+    c (m x n) = a (m x k) * w' in int32, where 'w' is n x k, one row per output unit.
+
+    Values are int8 / uint8 widened to int16, so the dot products accumulated in int32 are vectorized
+    as multiply-add pairs (pmaddwd). Four rows of 'a' share every load of a weight row.
+*/
+void dotProducts(const int16_t* a, int m, int k, const int16_t* w, int n, int32_t* c) {
+    int i = 0;
+    for (; i + 4 <= m; i += 4) {
+        const int16_t* x0 = a + (size_t)i * k;
+        const int16_t* x1 = x0 + k;
+        const int16_t* x2 = x1 + k;
+        const int16_t* x3 = x2 + k;
+        for (int j = 0; j < n; ++j) {
+            const int16_t* weights = w + (size_t)j * k;
+            int32_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+            for (int p = 0; p < k; ++p) {
+                int32_t weight = weights[p];
+                s0 += x0[p] * weight;
+                s1 += x1[p] * weight;
+                s2 += x2[p] * weight;
+                s3 += x3[p] * weight;
+            }
+            c[(size_t)i * n + j] = s0;
+            c[(size_t)(i + 1) * n + j] = s1;
+            c[(size_t)(i + 2) * n + j] = s2;
+            c[(size_t)(i + 3) * n + j] = s3;
+        }
+    }
+    for (; i < m; ++i) {
+        const int16_t* x = a + (size_t)i * k;
+        for (int j = 0; j < n; ++j) {
+            const int16_t* weights = w + (size_t)j * k;
+            int32_t sum = 0;
+            for (int p = 0; p < k; ++p) {
+                sum += x[p] * weights[p];
+            }
+            c[(size_t)i * n + j] = sum;
+        }
+    }
+}
+
+/**
+    Quantizes the transposed k x n float weights 'w' into n x k int8 rows (stored widened to int16),
+    with one symmetric scale per row.
+*/
+void quantizeRows(const float* w, int k, int n, std::vector<int16_t>& quantized,
+                  std::vector<float>& scales) {
+    scales.assign(n, 0);
+    for (int p = 0; p < k; ++p) {
+        for (int j = 0; j < n; ++j) {
+            scales[j] = std::max(scales[j], std::fabs(w[(size_t)p * n + j]));
+        }
+    }
+    for (auto& scale : scales) {
+        scale = (scale > 0) ? scale / 127 : 1;
+    }
+    quantized.resize((size_t)k * n);
+    for (int p = 0; p < k; ++p) {
+        for (int j = 0; j < n; ++j) {
+            quantized[(size_t)j * k + p] = (int16_t)std::lround(w[(size_t)p * n + j] / scales[j]);
+        }
+    }
+}
+
+// the sigmoid table covers [-SigmoidRange, SigmoidRange) in steps of 1 / SigmoidSteps
+const int SigmoidRange = 8;
+const int SigmoidSteps = 256;
+
+/**
+    round(255 * sigmoid(z)) for z in [-SigmoidRange, SigmoidRange).
+*/
+struct SigmoidTable {
+    uint8_t values[2 * SigmoidRange * SigmoidSteps];
+
+    SigmoidTable() {
+        for (int i = 0; i < 2 * SigmoidRange * SigmoidSteps; ++i) {
+            double z = (i + 0.5) / SigmoidSteps - SigmoidRange;
+            values[i] = (uint8_t)std::lround(255 / (1 + std::exp(-z)));
+        }
+    }
+
+    uint8_t operator()(float z) const {
+        int i = (int)((z + SigmoidRange) * SigmoidSteps);
+        i = std::min(std::max(i, 0), 2 * SigmoidRange * SigmoidSteps - 1);
+        return values[i];
+    }
+};
+
+const SigmoidTable sigmoidTable;
+
+void sigmoid(float* items, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        items[i] = 1.f / (1.f + std::exp(-items[i]));
+    }
+}
+
+struct OctaveMatrix {
+    int rows = 0;
+    int columns = 0;
+    std::vector<double> items;
+};
+
+/**
+    Reads every matrix of an Octave text file ("# name:", "# rows:" and "# columns:" headers).
+*/
+std::map<std::string, OctaveMatrix> readOctaveMatrices(const std::string& path) {
+    std::ifstream fs(path);
+    if (!fs) {
+        throw NetworkException("Can't open " + path + ".");
+    }
+    std::map<std::string, OctaveMatrix> ret;
+    std::string line;
+    std::string name;
+    OctaveMatrix matrix;
+    while (std::getline(fs, line)) {
+        if (line.compare(0, 8, "# name: ") == 0) {
+            name = line.substr(8);
+            matrix = OctaveMatrix();
+        } else if (line.compare(0, 8, "# rows: ") == 0) {
+            matrix.rows = std::atoi(line.c_str() + 8);
+        } else if (line.compare(0, 11, "# columns: ") == 0) {
+            matrix.columns = std::atoi(line.c_str() + 11);
+            matrix.items.resize((size_t)matrix.rows * matrix.columns);
+            for (auto& item : matrix.items) {
+                if (!(fs >> item)) {
+                    throw NetworkException("Matrix " + name + " is truncated in " + path + ".");
+                }
+            }
+            ret[name] = std::move(matrix);
+        }
+    }
+    return ret;
+}
+
+/**
+    Index of the best scoring choice of a job's block of 'length' + 1 scores that the job fits on,
+    'nodes' holds the capacities left. Leaving the job unassigned always fits, ties go to the
+    lower index like std::max_element.
+*/
+template <typename T>
+int bestFeasible(const float* scores, const T* job, const T* nodes, int length, int dimension) {
+    int best = 0;
+    for (int n = 1; n <= length; ++n) {
+        if (scores[n] <= scores[best]) {
+            continue;
+        }
+        const T* node = nodes + (n - 1) * dimension;
+        bool fits = true;
+        for (int d = 0; d < dimension; ++d) {
+            fits &= job[d] <= node[d];
+        }
+        if (fits) {
+            best = n;
+        }
+    }
+    return best;
+}
+
+}
+
+void decodeLabels(const float* outputs, long sampleCount, int length, uint8_t* labels) {
+    int block = length + 1;
+    for (long k = 0; k < sampleCount; ++k) {
+        const float* sample = outputs + k * length * block;
+        for (int i = 0; i < length; ++i) {
+            const float* scores = sample + i * block;
+            labels[k * length + i] = std::max_element(scores, scores + block) - scores;
+        }
+    }
+}
+
+void decodeFeasibleLabels(const float* outputs, const uint8_t* samples, long sampleCount, int length, int dimension,
+                          uint8_t* labels, std::vector<int>& residual) {
+    int block = length + 1;
+    int nodeSize = length * dimension;
+    std::vector<int> job(dimension);
+    for (long k = 0; k < sampleCount; ++k) {
+        const uint8_t* sample = samples + k * 2 * nodeSize;
+        residual.assign(sample, sample + nodeSize);
+        for (int i = 0; i < length; ++i) {
+            const uint8_t* resources = sample + nodeSize + i * dimension;
+            job.assign(resources, resources + dimension);
+            int node = bestFeasible(outputs + (k * length + i) * block, job.data(), residual.data(), length, dimension);
+            labels[k * length + i] = node;
+            if (node != 0) {
+                for (int d = 0; d < dimension; ++d) {
+                    residual[(node - 1) * dimension + d] -= job[d];
+                }
+            }
+        }
+    }
+}
+
+Network::Network(int length, int dimension, int hidden,
+                 const std::vector<double>& theta1, const std::vector<double>& theta2)
+: mLength(length), mDimension(dimension), mInputs(featureCount(length, dimension)),
+  mHidden(hidden), mOutputs(length * (length + 1)) {
+    if (theta1.size() != (size_t)mHidden * (mInputs + 1) || theta2.size() != (size_t)mOutputs * (mHidden + 1)) {
+        throw NetworkException("The weights don't match the queue length and dimension.");
+    }
+    auto weights = std::make_shared<std::vector<float>>((size_t)(mInputs + 1) * mHidden + (size_t)(mHidden + 1) * mOutputs);
+    float* weights1 = weights->data();
+    float* bias1 = weights1 + (size_t)mInputs * mHidden;
+    float* weights2 = bias1 + mHidden;
+    float* bias2 = weights2 + (size_t)mHidden * mOutputs;
+    for (int h = 0; h < mHidden; ++h) {
+        bias1[h] = theta1[(size_t)h * (mInputs + 1)];
+        for (int i = 0; i < mInputs; ++i) {
+            weights1[(size_t)i * mHidden + h] = theta1[(size_t)h * (mInputs + 1) + i + 1];
+        }
+    }
+    for (int o = 0; o < mOutputs; ++o) {
+        bias2[o] = theta2[(size_t)o * (mHidden + 1)];
+        for (int h = 0; h < mHidden; ++h) {
+            weights2[(size_t)h * mOutputs + o] = theta2[(size_t)o * (mHidden + 1) + h + 1];
+        }
+    }
+    mOwned = weights;
+    mWeights1 = weights1;
+    mBias1 = bias1;
+    mWeights2 = weights2;
+    mBias2 = bias2;
+}
+
+Network::Network(const std::shared_ptr<const ModelFile>& model)
+: mLength(model->shape().length), mDimension(model->shape().dimension), mInputs(model->shape().inputs),
+  mHidden(model->shape().hidden), mOutputs(model->shape().outputs), mModel(model) {
+    if (model->shape().features != FeatureVersion) {
+        throw NetworkException(model->path() + " was trained on another version of the features.");
+    }
+    if (mLength <= 0 || mDimension <= 0 || mHidden <= 0 || mInputs != featureCount(mLength, mDimension)
+        || mOutputs != mLength * (mLength + 1)) {
+        throw NetworkException("The dimensions in " + model->path() + " are inconsistent.");
+    }
+    try {
+        mWeights1 = model->get<float>(ModelSection::Weights1, (size_t)mInputs * mHidden);
+        mBias1 = model->get<float>(ModelSection::Bias1, mHidden);
+        mWeights2 = model->get<float>(ModelSection::Weights2, (size_t)mHidden * mOutputs);
+        mBias2 = model->get<float>(ModelSection::Bias2, mOutputs);
+    } catch(const ModelException& e) {
+        throw NetworkException(e.what());
+    }
+}
+
+Network Network::load(const std::string& path, int length, int dimension) {
+    if (isModelFile(path)) {
+        std::shared_ptr<const ModelFile> model;
+        try {
+            model = std::make_shared<const ModelFile>(path);
+        } catch(const ModelException& e) {
+            throw NetworkException(e.what());
+        }
+        Network ret(model);
+        if (ret.length() != length || ret.dimension() != dimension) {
+            throw NetworkException("The network in " + path + " doesn't match the queue length and dimension.");
+        }
+        return ret;
+    }
+    auto matrices = readOctaveMatrices(path);
+    auto theta1 = matrices.find("Theta1");
+    auto theta2 = matrices.find("Theta2");
+    if (theta1 == matrices.end() || theta2 == matrices.end()) {
+        throw NetworkException("Theta1 or Theta2 is missing from " + path + ".");
+    }
+    if (theta1->second.columns != featureCount(length, dimension) + 1
+        || theta2->second.columns != theta1->second.rows + 1) {
+        throw NetworkException("The weights in " + path + " don't match the queue length and dimension.");
+    }
+    return Network(length, dimension, theta1->second.rows, theta1->second.items, theta2->second.items);
+}
+
+void Network::save(const std::string& path, bool quantized) const {
+    ModelShape shape;
+    shape.length = mLength;
+    shape.dimension = mDimension;
+    shape.inputs = mInputs;
+    shape.hidden = mHidden;
+    shape.outputs = mOutputs;
+    shape.features = FeatureVersion;
+    ModelFileWriter writer(shape);
+    writer.add(ModelSection::Weights1, mWeights1, (size_t)mInputs * mHidden);
+    writer.add(ModelSection::Bias1, mBias1, mHidden);
+    writer.add(ModelSection::Weights2, mWeights2, (size_t)mHidden * mOutputs);
+    writer.add(ModelSection::Bias2, mBias2, mOutputs);
+    if (quantized) {
+        QuantizedNetwork(*this).addTo(writer);
+    }
+    try {
+        writer.commit(path);
+    } catch(const ModelException& e) {
+        throw NetworkException(e.what());
+    }
+}
+
+void Network::forward(const float* features, int sampleCount, float* output, NetworkScratch& scratch) const {
+    scratch.hidden.resize((size_t)sampleCount * mHidden);
+    firstLayer(features, sampleCount, mInputs, mWeights1, mBias1, mHidden, scratch.hidden.data(), scratch);
+    sigmoid(scratch.hidden.data(), scratch.hidden.size());
+    gemm(scratch.hidden.data(), sampleCount, mHidden, mWeights2, mBias2, mOutputs, output);
+}
+
+void Network::predict(const uint8_t* samples, long sampleCount, uint8_t* labels, NetworkScratch& scratch,
+                      bool feasible) const {
+    int sampleSize = 2 * mLength * mDimension;
+    scratch.features.resize((size_t)BatchSize * mInputs);
+    scratch.output.resize((size_t)BatchSize * mOutputs);
+    for (long first = 0; first < sampleCount; first += BatchSize) {
+        int count = std::min((long)BatchSize, sampleCount - first);
+        computeFeatures(samples + first * sampleSize, count, mLength, mDimension, scratch.features.data());
+        forward(scratch.features.data(), count, scratch.output.data(), scratch);
+        if (feasible) {
+            decodeFeasibleLabels(scratch.output.data(), samples + first * sampleSize, count, mLength, mDimension,
+                                 labels + first * mLength, scratch.residual);
+        } else {
+            decodeLabels(scratch.output.data(), count, mLength, labels + first * mLength);
+        }
+    }
+}
+
+InferenceSession::InferenceSession(const std::shared_ptr<const Network>& network)
+: mNetwork(network), mOutputRows((size_t)network->hidden() * network->outputs()), mFeatures(network->inputs()),
+  mNonzeros(network->inputs()), mPreActivations(network->hidden()), mActivations(network->hidden()),
+  mScores(network->length() + 1) {
+    int hidden = network->hidden();
+    int outputs = network->outputs();
+    for (int h = 0; h < hidden; ++h) {
+        for (int o = 0; o < outputs; ++o) {
+            mOutputRows[(size_t)o * hidden + h] = network->weights2()[(size_t)h * outputs + o];
+        }
+    }
+}
+
+void InferenceSession::reset(const uint8_t* sample) {
+    computeFeatures(sample, 1, mNetwork->length(), mNetwork->dimension(), mFeatures.data());
+    resync();
+}
+
+void InferenceSession::resync() {
+    int count = findNonzeros(mFeatures.data(), mNetwork->inputs(), mNonzeros.data());
+    sparseRow(mFeatures.data(), mNonzeros.data(), count, mNetwork->weights1(), mNetwork->bias1(), mNetwork->hidden(),
+              mPreActivations.data());
+    mUpdates = 0;
+    mStale = true;
+}
+
+void InferenceSession::setFeature(int index, float value) {
+    float delta = value - mFeatures[index];
+    if (delta == 0) {
+        return;
+    }
+    mFeatures[index] = value;
+    int hidden = mNetwork->hidden();
+    const float* row = mNetwork->weights1() + (size_t)index * hidden;
+    for (int h = 0; h < hidden; ++h) {
+        mPreActivations[h] += delta * row[h];
+    }
+    ++mUpdates;
+    mStale = true;
+}
+
+void InferenceSession::setNode(int node, const uint8_t* resources) {
+    int length = mNetwork->length();
+    int dimension = mNetwork->dimension();
+    setFeature(node, harmonicMean(resources, dimension));
+    for (int d = 0; d < dimension; ++d) {
+        setFeature(2 * length + node * dimension + d, resources[d]);
+    }
+}
+
+void InferenceSession::setJob(int job, const uint8_t* resources) {
+    int length = mNetwork->length();
+    int dimension = mNetwork->dimension();
+    setFeature(length + job, harmonicMean(resources, dimension));
+    for (int d = 0; d < dimension; ++d) {
+        setFeature(2 * length + (length + job) * dimension + d, resources[d]);
+    }
+}
+
+void InferenceSession::scoreJob(int job) {
+    if (mUpdates >= ResyncInterval) {
+        // the rounding errors of the updates add up
+        resync();
+    }
+    if (mStale) {
+        std::copy(mPreActivations.begin(), mPreActivations.end(), mActivations.begin());
+        sigmoid(mActivations.data(), mActivations.size());
+        mStale = false;
+    }
+    // only the job's own block of outputs
+    const int Lanes = 8;
+    int block = mNetwork->length() + 1;
+    int hidden = mNetwork->hidden();
+    for (int o = 0; o < block; ++o) {
+        const float* row = mOutputRows.data() + (size_t)(job * block + o) * hidden;
+        // independent partial sums, so the dot product vectorizes
+        float partial[Lanes] = {};
+        int h = 0;
+        for (; h + Lanes <= hidden; h += Lanes) {
+            for (int l = 0; l < Lanes; ++l) {
+                partial[l] += mActivations[h + l] * row[h + l];
+            }
+        }
+        float score = mNetwork->bias2()[job * block + o];
+        for (; h < hidden; ++h) {
+            score += mActivations[h] * row[h];
+        }
+        for (int l = 0; l < Lanes; ++l) {
+            score += partial[l];
+        }
+        mScores[o] = score;
+    }
+}
+
+int InferenceSession::place(int job) {
+    scoreJob(job);
+    return std::max_element(mScores.begin(), mScores.end()) - mScores.begin();
+}
+
+int InferenceSession::placeFeasible(int job) {
+    scoreJob(job);
+    int length = mNetwork->length();
+    int dimension = mNetwork->dimension();
+    // the resource features are the items themselves
+    const float* nodes = mFeatures.data() + 2 * length;
+    const float* resources = nodes + (length + job) * dimension;
+    return bestFeasible(mScores.data(), resources, nodes, length, dimension);
+}
+
+QuantizedNetwork::QuantizedNetwork(const Network& network)
+: mLength(network.length()), mDimension(network.dimension()), mInputs(network.inputs()),
+  mHidden(network.hidden()), mOutputs(network.outputs()), mBias1(network.bias1(), network.bias1() + mHidden),
+  mBias2(network.bias2(), network.bias2() + mOutputs) {
+    quantizeRows(network.weights1(), mInputs, mHidden, mWeights1, mScale1);
+    quantizeRows(network.weights2(), mHidden, mOutputs, mWeights2, mScale2);
+    // the hidden activations are sigmoid * 255
+    for (auto& scale : mScale2) {
+        scale /= 255;
+    }
+}
+
+QuantizedNetwork::QuantizedNetwork(const ModelFile& model)
+: mLength(model.shape().length), mDimension(model.shape().dimension), mInputs(model.shape().inputs),
+  mHidden(model.shape().hidden), mOutputs(model.shape().outputs) {
+    try {
+        auto weights1 = model.get<int8_t>(ModelSection::QuantizedWeights1, (size_t)mHidden * mInputs);
+        auto weights2 = model.get<int8_t>(ModelSection::QuantizedWeights2, (size_t)mOutputs * mHidden);
+        mWeights1.assign(weights1, weights1 + (size_t)mHidden * mInputs);
+        mWeights2.assign(weights2, weights2 + (size_t)mOutputs * mHidden);
+        auto scale1 = model.get<float>(ModelSection::Scale1, mHidden);
+        auto scale2 = model.get<float>(ModelSection::Scale2, mOutputs);
+        mScale1.assign(scale1, scale1 + mHidden);
+        mScale2.assign(scale2, scale2 + mOutputs);
+        auto bias1 = model.get<float>(ModelSection::Bias1, mHidden);
+        auto bias2 = model.get<float>(ModelSection::Bias2, mOutputs);
+        mBias1.assign(bias1, bias1 + mHidden);
+        mBias2.assign(bias2, bias2 + mOutputs);
+    } catch(const ModelException& e) {
+        throw NetworkException(e.what());
+    }
+}
+
+void QuantizedNetwork::addTo(ModelFileWriter& writer) const {
+    std::vector<int8_t> weights1(mWeights1.begin(), mWeights1.end());
+    std::vector<int8_t> weights2(mWeights2.begin(), mWeights2.end());
+    writer.add(ModelSection::QuantizedWeights1, weights1.data(), weights1.size());
+    writer.add(ModelSection::Scale1, mScale1.data(), mScale1.size());
+    writer.add(ModelSection::QuantizedWeights2, weights2.data(), weights2.size());
+    writer.add(ModelSection::Scale2, mScale2.data(), mScale2.size());
+}
+
+void QuantizedNetwork::predict(const uint8_t* samples, long sampleCount, uint8_t* labels,
+                               QuantizedScratch& scratch, bool feasible) const {
+    int sampleSize = 2 * mLength * mDimension;
+    scratch.features.resize((size_t)BatchSize * mInputs);
+    scratch.inputs.resize((size_t)BatchSize * mInputs);
+    scratch.sums.resize((size_t)BatchSize * std::max(mHidden, mOutputs));
+    scratch.hidden.resize((size_t)BatchSize * mHidden);
+    scratch.output.resize((size_t)BatchSize * mOutputs);
+    for (long first = 0; first < sampleCount; first += BatchSize) {
+        int count = std::min((long)BatchSize, sampleCount - first);
+        computeFeatures(samples + first * sampleSize, count, mLength, mDimension, scratch.features.data());
+        for (size_t i = 0; i < (size_t)count * mInputs; ++i) {
+            // features are never negative
+            scratch.inputs[i] = (int16_t)(scratch.features[i] + 0.5f);
+        }
+
+        dotProducts(scratch.inputs.data(), count, mInputs, mWeights1.data(), mHidden, scratch.sums.data());
+        for (int k = 0; k < count; ++k) {
+            const int32_t* sums = scratch.sums.data() + (size_t)k * mHidden;
+            int16_t* hidden = scratch.hidden.data() + (size_t)k * mHidden;
+            for (int h = 0; h < mHidden; ++h) {
+                hidden[h] = sigmoidTable(mBias1[h] + mScale1[h] * sums[h]);
+            }
+        }
+
+        dotProducts(scratch.hidden.data(), count, mHidden, mWeights2.data(), mOutputs, scratch.sums.data());
+        for (int k = 0; k < count; ++k) {
+            const int32_t* sums = scratch.sums.data() + (size_t)k * mOutputs;
+            float* output = scratch.output.data() + (size_t)k * mOutputs;
+            for (int o = 0; o < mOutputs; ++o) {
+                output[o] = mBias2[o] + mScale2[o] * sums[o];
+            }
+        }
+        if (feasible) {
+            decodeFeasibleLabels(scratch.output.data(), samples + first * sampleSize, count, mLength, mDimension,
+                                 labels + first * mLength, scratch.residual);
+        } else {
+            decodeLabels(scratch.output.data(), count, mLength, labels + first * mLength);
+        }
+    }
+}
+
+NetworkWatcher::NetworkWatcher(const std::string& path, int length, int dimension)
+: mPath(path), mLength(length), mDimension(dimension) {
+    if (!refresh()) {
+        throw NetworkException("Can't open " + path + ".");
+    }
+}
+
+std::shared_ptr<const Network> NetworkWatcher::get() const {
+    return std::atomic_load(&mNetwork);
+}
+
+bool NetworkWatcher::refresh() {
+    struct stat st;
+    if (::stat(mPath.c_str(), &st) != 0) {
+        return false;
+    }
+    if (mNetwork && st.st_dev == mDevice && st.st_ino == mInode && st.st_mtim.tv_sec == mModified
+        && st.st_mtim.tv_nsec == mModifiedNanoseconds) {
+        return false;
+    }
+    // a broken file is reported once, not on every refresh
+    mDevice = st.st_dev;
+    mInode = st.st_ino;
+    mModified = st.st_mtim.tv_sec;
+    mModifiedNanoseconds = st.st_mtim.tv_nsec;
+    auto network = std::make_shared<const Network>(Network::load(mPath, mLength, mDimension));
+    std::atomic_store(&mNetwork, network);
+    return true;
+}
@@ -0,0 +1,301 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#pragma once
+
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Features.h"
+#include "ModelFile.h"
+
+class NetworkException : public std::exception {
+private:
+    std::string m_message;
+public:
+    NetworkException(const std::string& message) : m_message(message) {
+        // empty
+    }
+
+    virtual const char* what() const noexcept {
+        return m_message.c_str();
+    }
+};
+
+/**
+    Reusable buffers of Network::predict().
+*/
+struct NetworkScratch {
+    std::vector<float> features;
+    std::vector<float> hidden;
+    std::vector<float> output;
+    // the first layer splits a batch into sparse and dense samples
+    std::vector<int> nonzeros;
+    std::vector<int> denseRows;
+    std::vector<float> denseFeatures;
+    std::vector<float> denseHidden;
+    // residual capacities of the nodes, see decodeFeasibleLabels()
+    std::vector<int> residual;
+};
+
+/**
+    The placement network trained by octave/main.m: one sigmoid hidden layer and
+    'length' * ('length' + 1) sigmoid outputs, a block of 'length' + 1 per job.
+
+    Weights are stored transposed (input major) with the biases separated, so every layer is
+    a row major GEMM whose innermost loop runs over contiguous output units. Blank nodes and jobs
+    have zero features, the first layer skips their rows of weights in samples with many of them.
+
+    The weights are immutable, either owned or used in place from a memory mapped model file,
+    and copies of a Network share them.
+*/
+class Network {
+private:
+    int mLength;
+    int mDimension;
+    int mInputs;
+    int mHidden;
+    int mOutputs;
+    // keep the weights alive, one of them is set
+    std::shared_ptr<const std::vector<float>> mOwned;
+    std::shared_ptr<const ModelFile> mModel;
+    // mInputs x mHidden
+    const float* mWeights1;
+    const float* mBias1;
+    // mHidden x mOutputs
+    const float* mWeights2;
+    const float* mBias2;
+public:
+    /**
+        'theta1' (hidden x (inputs + 1)) and 'theta2' (outputs x (hidden + 1)) are row major,
+        with the bias in the first column, like Theta1 and Theta2 in octave/main.m.
+    */
+    Network(int length, int dimension, int hidden,
+            const std::vector<double>& theta1, const std::vector<double>& theta2);
+
+    /**
+        Uses the weights of a model file in place, see save().
+    */
+    explicit Network(const std::shared_ptr<const ModelFile>& model);
+
+    /**
+        Loads Theta1 and Theta2 from an Octave text file ("save weights.txt Theta1 Theta2"),
+        or maps a model file (see save()).
+    */
+    static Network load(const std::string& path, int length, int dimension);
+
+    /**
+        Saves the network as a model file, with the int8 version of the weights if 'quantized'.
+        The file is replaced atomically, see ModelFileWriter.
+    */
+    void save(const std::string& path, bool quantized) const;
+
+    int length() const {return mLength;}
+    int dimension() const {return mDimension;}
+    int inputs() const {return mInputs;}
+    int hidden() const {return mHidden;}
+    int outputs() const {return mOutputs;}
+    const float* weights1() const {return mWeights1;}
+    const float* bias1() const {return mBias1;}
+    const float* weights2() const {return mWeights2;}
+    const float* bias2() const {return mBias2;}
+
+    /**
+        The mapped model file of the weights, null if they are owned.
+    */
+    const std::shared_ptr<const ModelFile>& model() const {return mModel;}
+
+    /**
+        Predicts the node of every job of 'sampleCount' samples, 'length' compact labels per sample
+        (0 means unassigned), decoded like octave/predict.m: the biggest output of each job's block wins.
+
+        The output sigmoid is monotonic, so the argmax is taken on the pre-activations.
+        With 'feasible' the labels are decoded by decodeFeasibleLabels() instead.
+    */
+    void predict(const uint8_t* samples, long sampleCount, uint8_t* labels, NetworkScratch& scratch,
+                 bool feasible = false) const;
+
+    /**
+        The raw outputs (before the sigmoid) of a batch of 'sampleCount' feature rows.
+    */
+    void forward(const float* features, int sampleCount, float* output, NetworkScratch& scratch) const;
+};
+
+/**
+    Writes the argmax of every job's block of 'outputs' as compact labels (first maximum wins).
+*/
+void decodeLabels(const float* outputs, long sampleCount, int length, uint8_t* labels);
+
+/**
+    Like decodeLabels(), but every job only chooses among the nodes it fits on: jobs are placed in
+    queue order, each on the best scoring node of its block that has the capacity left, or left
+    unassigned if that scores higher. A job whose argmax fits keeps it.
+
+    The capacities left on the nodes are kept in 'residual' and updated after every job, so a job
+    costs one pass over its block, O(length * dimension).
+*/
+void decodeFeasibleLabels(const float* outputs, const uint8_t* samples, long sampleCount, int length, int dimension,
+                          uint8_t* labels, std::vector<int>& residual);
+
+/**
+    Stateful inference for online placement, where consecutive decisions only differ in a few items
+    (the arriving job, the capacity left on the node that took the previous one).
+
+    The session keeps the features and the hidden pre-activations of the current queue. Changing an
+    item updates the pre-activations by the changed features times their rows of the first layer
+    (a rank-k update instead of the full product), and placing a job only computes its own block
+    of outputs. The rounding errors of the updates add up, so the pre-activations are recomputed
+    from the features every ResyncInterval updates. Results are the same as Network::predict() up
+    to float rounding, see evaluate --session.
+
+    The session shares the network, e.g. a NetworkWatcher::get() snapshot stays alive as long as
+    the session uses it.
+*/
+class InferenceSession {
+private:
+    std::shared_ptr<const Network> mNetwork;
+    // the second layer in the Theta2 layout (outputs x hidden), a job's block is contiguous
+    std::vector<float> mOutputRows;
+    std::vector<float> mFeatures;
+    std::vector<int> mNonzeros;
+    std::vector<float> mPreActivations;
+    std::vector<float> mActivations;
+    std::vector<float> mScores;
+    bool mStale = true;
+    // feature updates since the last full pass
+    int mUpdates = 0;
+
+    void setFeature(int index, float value);
+    void resync();
+    void scoreJob(int job);
+public:
+    // without resyncs about 1 in 1300 placements of a long replay differ from Network::predict()
+    static const int ResyncInterval = 1024;
+
+    explicit InferenceSession(const std::shared_ptr<const Network>& network);
+
+    const Network& network() const {return *mNetwork;}
+
+    /**
+        Starts from a whole sample (full first layer pass).
+    */
+    void reset(const uint8_t* sample);
+
+    /**
+        Changes the resources of node 'node' (0 based) to 'resources'.
+    */
+    void setNode(int node, const uint8_t* resources);
+
+    /**
+        Changes job 'job' (0 based) to 'resources', e.g. a new arrival in a free slot.
+    */
+    void setJob(int job, const uint8_t* resources);
+
+    /**
+        Returns the predicted node of job 'job' (0 means unassigned, 'n' is the n-th node).
+    */
+    int place(int job);
+
+    /**
+        Like place(), but only chooses among the nodes the job fits on, see decodeFeasibleLabels().
+        The node resources of the session are the capacities left, the caller updates the chosen
+        node with setNode() before the next decision.
+    */
+    int placeFeasible(int job);
+};
+
+/**
+    Reusable buffers of QuantizedNetwork::predict().
+*/
+struct QuantizedScratch {
+    std::vector<float> features;
+    // uint8 activations, widened for the multiply-adds
+    std::vector<int16_t> inputs;
+    std::vector<int32_t> sums;
+    std::vector<int16_t> hidden;
+    std::vector<float> output;
+    std::vector<int> residual;
+};
+
+/**
+    Int8 version of a Network.
+
+    Weights are symmetric int8 rows, one row and one scale per output unit. Activations are uint8:
+    the inputs are resources and harmonic means (rounded), the hidden layer is sigmoid * 255 read
+    from a table. Products are accumulated in int32 and only the final sums are scaled back to float.
+
+    Both are kept widened to int16, the operand size of the SSE2 multiply-add, which avoids
+    widening in the inner loop. The weights of the default network take 200 KB, half of the float ones.
+*/
+class QuantizedNetwork {
+private:
+    int mLength;
+    int mDimension;
+    int mInputs;
+    int mHidden;
+    int mOutputs;
+    // mHidden x mInputs, int8 values
+    std::vector<int16_t> mWeights1;
+    std::vector<float> mScale1;
+    std::vector<float> mBias1;
+    // mOutputs x mHidden, int8 values
+    std::vector<int16_t> mWeights2;
+    std::vector<float> mScale2;
+    std::vector<float> mBias2;
+public:
+    explicit QuantizedNetwork(const Network& network);
+
+    /**
+        Reads the quantized weights saved by Network::save(). They are widened to int16 on load.
+    */
+    explicit QuantizedNetwork(const ModelFile& model);
+
+    /**
+        Adds the int8 weights and their scales to a model file.
+    */
+    void addTo(ModelFileWriter& writer) const;
+
+    /**
+        Same as Network::predict().
+    */
+    void predict(const uint8_t* samples, long sampleCount, uint8_t* labels, QuantizedScratch& scratch,
+                 bool feasible = false) const;
+};
+
+/**
+    Hot swappable network of a model file, for long running services.
+
+    refresh() maps the file again when it was replaced (a new inode or modification time), e.g.
+    by Network::save() or "mv new.model model", and swaps it in. Callers take the current network
+    with get() from any thread and keep it as long as they need it, e.g. for an InferenceSession,
+    so a swap never pulls the weights out from under a running decision. refresh() is called from
+    one thread, e.g. a timer.
+*/
+class NetworkWatcher {
+private:
+    std::string mPath;
+    int mLength;
+    int mDimension;
+    // read and replaced with std::atomic_load() and std::atomic_store()
+    std::shared_ptr<const Network> mNetwork;
+    // identity of the loaded file
+    unsigned long mDevice = 0;
+    unsigned long mInode = 0;
+    long mModified = 0;
+    long mModifiedNanoseconds = 0;
+public:
+    /**
+        Loads the network, throws NetworkException if it can't.
+    */
+    NetworkWatcher(const std::string& path, int length, int dimension);
+
+    std::shared_ptr<const Network> get() const;
+
+    /**
+        Returns true if a new version of the file was swapped in. Throws NetworkException if the file
+        was replaced by one that can't be loaded, the current network stays in place.
+    */
+    bool refresh();
+};
@@ -0,0 +1,256 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <unistd.h>
+
+#include "FileIO.h"
+#include "OctaveBinary.h"
+
+namespace {
+
+// "Octave-1-L" and the IEEE little endian float format
+const char Magic[11] = {'O', 'c', 't', 'a', 'v', 'e', '-', '1', '-', 'L', 0};
+// the column buffer is written out at this size
+const size_t BufferSize = 1 << 20;
+// longest header read by readOctaveRecords(), the variable name is the only variable length part
+const long HeaderLimit = 4096;
+
+void putInt32(std::vector<char>& out, int32_t value) {
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(value));
+}
+
+void putString(std::vector<char>& out, const std::string& value) {
+    putInt32(out, value.size());
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+bool getInt32(const char*& p, const char* end, int32_t& value) {
+    if (end - p < (long)sizeof(value)) {
+        return false;
+    }
+    std::memcpy(&value, p, sizeof(value));
+    p += sizeof(value);
+    return true;
+}
+
+bool getString(const char*& p, const char* end, std::string& value) {
+    int32_t length;
+    if (!getInt32(p, end, length) || length < 0 || end - p < length) {
+        return false;
+    }
+    value.assign(p, length);
+    p += length;
+    return true;
+}
+
+template <typename T>
+void putItems(std::vector<char>& out, const double* items, int count) {
+    size_t offset = out.size();
+    out.resize(offset + sizeof(T) * count);
+    T* converted = reinterpret_cast<T*>(out.data() + offset);
+    for (int i = 0; i < count; ++i) {
+        converted[i] = (T)items[i];
+    }
+}
+
+size_t elementSize(OctaveType type) {
+    switch (type) {
+    case OctaveType::UInt8:
+        return sizeof(uint8_t);
+    case OctaveType::Float:
+        return sizeof(float);
+    case OctaveType::Double:
+        return sizeof(double);
+    }
+    return sizeof(double);
+}
+
+/**
+    Converts 'count' items of type T to bytes. Returns false if any of them isn't an integer in 0..255.
+*/
+template <typename T>
+bool getBytes(const char* data, int count, uint8_t* bytes) {
+    bool ret = true;
+    for (int i = 0; i < count; ++i) {
+        T item;
+        std::memcpy(&item, data + i * sizeof(T), sizeof(T));
+        ret = ret && item >= 0 && item <= 255 && item == (T)(int)item;
+        bytes[i] = ret ? (uint8_t)item : 0;
+    }
+    return ret;
+}
+
+}
+
+std::vector<char> encodeOctaveHeader(OctaveMatrixHeader& header) {
+    // see save_binary_data() and octave_matrix::save_binary() in Octave
+    std::vector<char> ret(Magic, Magic + sizeof(Magic));
+    putString(ret, header.name);
+    // no doc string, not global
+    putString(ret, "");
+    ret.push_back(0);
+    // the type name follows
+    ret.push_back((char)255);
+    putString(ret, "matrix");
+    // negative: the number of dimensions of the new format
+    putInt32(ret, -2);
+    header.rowsOffset = ret.size();
+    putInt32(ret, header.rows);
+    header.columnsOffset = ret.size();
+    putInt32(ret, header.columns);
+    ret.push_back((char)header.type);
+    header.dataOffset = ret.size();
+    return ret;
+}
+
+bool decodeOctaveHeader(const char* data, size_t size, OctaveMatrixHeader& header) {
+    const char* p = data;
+    const char* end = data + size;
+    if (size < sizeof(Magic) || std::memcmp(p, Magic, sizeof(Magic)) != 0) {
+        return false;
+    }
+    p += sizeof(Magic);
+    std::string doc;
+    std::string typeName;
+    int32_t dimensions;
+    if (!getString(p, end, header.name) || !getString(p, end, doc) || end - p < 2 || (unsigned char)p[1] != 255) {
+        return false;
+    }
+    p += 2;
+    if (!getString(p, end, typeName) || typeName != "matrix" || !getInt32(p, end, dimensions) || dimensions != -2) {
+        return false;
+    }
+    header.rowsOffset = p - data;
+    header.columnsOffset = header.rowsOffset + sizeof(int32_t);
+    if (!getInt32(p, end, header.rows) || !getInt32(p, end, header.columns) || p == end
+        || header.rows < 0 || header.columns < 0) {
+        return false;
+    }
+    auto type = (OctaveType)*p++;
+    if (type != OctaveType::UInt8 && type != OctaveType::Float && type != OctaveType::Double) {
+        return false;
+    }
+    header.type = type;
+    header.dataOffset = p - data;
+    return true;
+}
+
+bool readOctaveRecords(const std::string& path, ByteMatrix& matrix) {
+    std::ifstream fs(path, std::ios::binary|std::ios::ate);
+    if (!fs) {
+        return false;
+    }
+    long size = fs.tellg();
+    std::vector<char> head(std::min(size, HeaderLimit));
+    OctaveMatrixHeader header;
+    if (!fs.seekg(0) || !fs.read(head.data(), head.size()) || !decodeOctaveHeader(head.data(), head.size(), header)) {
+        return false;
+    }
+    size_t items = (size_t)header.rows * header.columns;
+    size_t itemSize = elementSize(header.type);
+    if ((size_t)(size - header.dataOffset) / itemSize < items) {
+        return false;
+    }
+    matrix.items.resize(items);
+    matrix.rows = header.columns;
+    matrix.columns = header.rows;
+    matrix.errors.clear();
+    if (!fs.seekg(header.dataOffset)) {
+        return false;
+    }
+    if (header.type == OctaveType::UInt8) {
+        // column major 'rows' x 'columns' is row major 'columns' x 'rows', read as it is
+        return (bool)fs.read(reinterpret_cast<char*>(matrix.items.data()), items);
+    }
+    // Octave saves doubles by default, a record whose items aren't all bytes is malformed
+    std::vector<char> record((size_t)header.rows * itemSize);
+    for (long k = 0; k < matrix.rows; ++k) {
+        if (!fs.read(record.data(), record.size())) {
+            return false;
+        }
+        uint8_t* row = matrix.items.data() + (size_t)k * matrix.columns;
+        bool valid = header.type == OctaveType::Float ? getBytes<float>(record.data(), matrix.columns, row)
+                                                      : getBytes<double>(record.data(), matrix.columns, row);
+        if (!valid) {
+            ParseError error;
+            error.offset = header.dataOffset + (size_t)k * record.size();
+            error.items = matrix.columns;
+            matrix.errors.push_back(error);
+        }
+    }
+    return true;
+}
+
+bool isOctaveBinary(const std::string& path) {
+    char magic[sizeof(Magic)];
+    std::ifstream fs(path, std::ios::binary);
+    return fs.read(magic, sizeof(magic)) && std::memcmp(magic, Magic, sizeof(Magic)) == 0;
+}
+
+OctaveMatrixWriter::OctaveMatrixWriter(const std::string& path, const std::string& name, int rows, OctaveType type)
+: mPath(path), mRows(rows), mType(type) {
+    OctaveMatrixHeader fields;
+    fields.name = name;
+    fields.rows = rows;
+    fields.type = type;
+    std::vector<char> header = encodeOctaveHeader(fields);
+    mColumnsOffset = fields.columnsOffset;
+
+    mFd = createTempFile(mPath, mTempPath);
+    mFailed = mFd < 0 || !writeAll(mFd, header.data(), header.size());
+    mBuffer.reserve(BufferSize);
+}
+
+OctaveMatrixWriter::~OctaveMatrixWriter() {
+    if (mFd >= 0) {
+        ::close(mFd);
+        ::unlink(mTempPath.c_str());
+    }
+}
+
+void OctaveMatrixWriter::flush() {
+    if (!mFailed) {
+        mFailed = !writeAll(mFd, mBuffer.data(), mBuffer.size());
+    }
+    mBuffer.clear();
+}
+
+void OctaveMatrixWriter::append(const double* column) {
+    switch (mType) {
+    case OctaveType::UInt8:
+        putItems<uint8_t>(mBuffer, column, mRows);
+        break;
+    case OctaveType::Float:
+        putItems<float>(mBuffer, column, mRows);
+        break;
+    case OctaveType::Double:
+        putItems<double>(mBuffer, column, mRows);
+        break;
+    }
+    ++mColumns;
+    if (mBuffer.size() >= BufferSize) {
+        flush();
+    }
+}
+
+bool OctaveMatrixWriter::commit() {
+    flush();
+    if (mFailed || mFd < 0) {
+        return false;
+    }
+    int32_t columns = mColumns;
+    bool ok = ::pwrite(mFd, &columns, sizeof(columns), mColumnsOffset) == (ssize_t)sizeof(columns);
+    int fd = mFd;
+    mFd = -1;
+    if (!ok) {
+        ::close(fd);
+        ::unlink(mTempPath.c_str());
+        return false;
+    }
+    return replaceFile(fd, mTempPath, mPath);
+}
@@ -0,0 +1,104 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "IntParser.h"
+
+/**
+    Element types of Octave's binary format (save_type in Octave's data-conv.h).
+    Octave converts every one of them to a double matrix on load.
+*/
+enum class OctaveType : uint8_t {
+    UInt8 = 0,
+    Float = 6,
+    Double = 7
+};
+
+/**
+    Header of a file holding one matrix variable in Octave's binary format.
+*/
+struct OctaveMatrixHeader {
+    std::string name;
+    int32_t rows = 0;
+    int32_t columns = 0;
+    OctaveType type = OctaveType::Double;
+    // file offsets of the two dimensions, patched as the matrix grows, and of the first item
+    size_t rowsOffset = 0;
+    size_t columnsOffset = 0;
+    size_t dataOffset = 0;
+};
+
+/**
+    Serializes 'header' and sets its offsets.
+*/
+std::vector<char> encodeOctaveHeader(OctaveMatrixHeader& header);
+
+/**
+    Parses the header of a file written by encodeOctaveHeader() or Octave's "save -binary" of a single
+    real matrix. Returns false if 'data' doesn't start with one.
+*/
+bool decodeOctaveHeader(const char* data, size_t size, OctaveMatrixHeader& header);
+
+/**
+    Reads a matrix saved one record per column (see DatasetWriter) into a ByteMatrix of one
+    record per row. uint8 items are read into the matrix as they are, without any parsing.
+    Float and double matrices (Octave's default) are converted, a record with an item that
+    isn't an integer in 0..255 is reported in 'matrix.errors' by its file offset.
+
+    Returns false if the file can't be read or isn't a matrix in Octave's binary format.
+*/
+bool readOctaveRecords(const std::string& path, ByteMatrix& matrix);
+
+/**
+    Whether the file starts with the magic of Octave's binary format.
+*/
+bool isOctaveBinary(const std::string& path);
+
+/**
+    Writes one matrix variable in Octave's binary format ("save -binary"), which load() reads
+    without parsing.
+
+    The format is column major, so the matrix is written a column at a time and the number of
+    columns is patched into the header by commit(). Records streamed in as columns make the
+    file hold the transpose of the dataset ('name' x records), which Octave transposes in memory.
+
+    The file is written next to a unique temporary name (createTempFile()) and renamed into place on commit(),
+    uncommitted files are removed by the destructor.
+*/
+class OctaveMatrixWriter {
+private:
+    std::string mPath;
+    std::string mTempPath;
+    int mRows;
+    OctaveType mType;
+    int mFd = -1;
+    long mColumns = 0;
+    // file offset of the column count in the header
+    long mColumnsOffset = 0;
+    bool mFailed = false;
+    std::vector<char> mBuffer;
+
+    void flush();
+public:
+    OctaveMatrixWriter(const std::string& path, const std::string& name, int rows, OctaveType type);
+    ~OctaveMatrixWriter();
+
+    OctaveMatrixWriter(const OctaveMatrixWriter&) = delete;
+    OctaveMatrixWriter& operator=(const OctaveMatrixWriter&) = delete;
+
+    long columns() const {return mColumns;}
+
+    /**
+        Appends a column of 'rows' items, converted to the element type of the file.
+    */
+    void append(const double* column);
+
+    /**
+        Returns false if the file couldn't be written.
+    */
+    bool commit();
+};
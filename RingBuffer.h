@@ -0,0 +1,137 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <utility>
+
+/**
+    Bounded lock-free multi producer / multi consumer queue.
+
+    Every cell carries a sequence number which tells producers and consumers
+    whether the cell is free to write or ready to read (D. Vyukov's design).
+    A single producer / single consumer pair is simply the special case.
+
+    push() and pop() spin (yielding the core) while the queue is full or empty.
+    After close() pop() drains the remaining items and then returns false.
+*/
+template <typename T>
+class RingBuffer {
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    std::unique_ptr<Cell[]> mBuffer;
+    size_t mMask;
+    alignas(64) std::atomic<size_t> mEnqueuePos;
+    alignas(64) std::atomic<size_t> mDequeuePos;
+    alignas(64) std::atomic<bool> mClosed;
+
+    static size_t roundUpToPowerOfTwo(size_t capacity) {
+        size_t ret = 2;
+        while (ret < capacity) {
+            ret <<= 1;
+        }
+        return ret;
+    }
+public:
+    explicit RingBuffer(size_t capacity)
+    : mBuffer(new Cell[roundUpToPowerOfTwo(capacity)]),
+      mMask(roundUpToPowerOfTwo(capacity) - 1),
+      mEnqueuePos(0),
+      mDequeuePos(0),
+      mClosed(false) {
+        for (size_t i = 0; i <= mMask; ++i) {
+            mBuffer[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    /**
+        Moves 'value' into the queue.
+
+        Returns false (leaving 'value' untouched) if the queue is full.
+    */
+    bool tryPush(T& value) {
+        size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = mBuffer[pos & mMask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)pos;
+            if (diff == 0) {
+                if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.data = std::move(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = mEnqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+        Moves the oldest item into 'value'.
+
+        Returns false if the queue is empty.
+    */
+    bool tryPop(T& value) {
+        size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = mBuffer[pos & mMask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)(pos + 1);
+            if (diff == 0) {
+                if (mDequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = std::move(cell.data);
+                    cell.sequence.store(pos + mMask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = mDequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void push(T value) {
+        while (!tryPush(value)) {
+            std::this_thread::yield();
+        }
+    }
+
+    /**
+        Waits for the next item.
+
+        Returns false once the queue is closed and fully drained.
+    */
+    bool pop(T& value) {
+        for (;;) {
+            if (tryPop(value)) {
+                return true;
+            }
+            if (mClosed.load(std::memory_order_acquire)) {
+                // items pushed right before close() must not be lost
+                return tryPop(value);
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    /**
+        Signals that no more items will be pushed.
+    */
+    void close() {
+        mClosed.store(true, std::memory_order_release);
+    }
+};
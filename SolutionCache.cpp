@@ -0,0 +1,239 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#include <algorithm>
+#include <numeric>
+#include <sstream>
+
+#include "AutoAnnotator.h"
+#include "SolutionCache.h"
+
+/**
+    Returns the item indices ordered by their resources, biggest first.
+*/
+static std::vector<int> sortedOrder(const std::vector<int>& queues, int offset, int length, int dimension) {
+    std::vector<int> order(length);
+    std::iota(order.begin(), order.end(), 0);
+    auto begin = queues.cbegin() + offset;
+    std::stable_sort(order.begin(), order.end(), [&] (int left, int right) -> bool {
+        return std::lexicographical_compare(begin + right * dimension, begin + (right + 1) * dimension,
+                                            begin + left * dimension, begin + (left + 1) * dimension);
+    });
+    return order;
+}
+
+/**
+    64 bit FNV-1a hash of the queues.
+*/
+static uint64_t hashQueues(const std::vector<int>& queues, int dimension) {
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash] (uint32_t value) {
+        for (int b = 0; b < 4; ++b) {
+            hash ^= (value >> (8 * b)) & 0xff;
+            hash *= 1099511628211ULL;
+        }
+    };
+    mix(dimension);
+    for (int item : queues) {
+        mix(item);
+    }
+    return hash;
+}
+
+/**
+    64 bit FNV-1a hash of the text of a cache entry.
+*/
+static uint64_t checksum(const char* data, size_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+CanonicalInstance canonicalize(const std::vector<int>& queues, int dimension) {
+    CanonicalInstance ret;
+    int length = queues.size() / 2 / dimension;
+    ret.nodeOrder = sortedOrder(queues, 0, length, dimension);
+    ret.jobOrder = sortedOrder(queues, length * dimension, length, dimension);
+    ret.queues.reserve(queues.size());
+    for (int i : ret.nodeOrder) {
+        for (int d = 0; d < dimension; ++d) {
+            ret.queues.push_back(queues[i * dimension + d]);
+        }
+    }
+    for (int i : ret.jobOrder) {
+        for (int d = 0; d < dimension; ++d) {
+            ret.queues.push_back(queues[length * dimension + i * dimension + d]);
+        }
+    }
+    ret.hash = hashQueues(ret.queues, dimension);
+    return ret;
+}
+
+std::vector<int> remapAnnotations(const CanonicalInstance& instance, const std::vector<int>& annotations) {
+    std::vector<int> ret(annotations.size(), 0);
+    for (size_t i = 0; i < annotations.size(); ++i) {
+        int node = annotations[i];
+        ret[instance.jobOrder[i]] = (node == 0) ? 0 : instance.nodeOrder[node - 1] + 1;
+    }
+    return ret;
+}
+
+std::vector<int> canonicalAnnotations(const CanonicalInstance& instance, const std::vector<int>& annotations) {
+    // position of every original node in the canonical order
+    std::vector<int> nodePosition(instance.nodeOrder.size());
+    for (size_t i = 0; i < instance.nodeOrder.size(); ++i) {
+        nodePosition[instance.nodeOrder[i]] = i;
+    }
+    std::vector<int> ret(annotations.size(), 0);
+    for (size_t i = 0; i < annotations.size(); ++i) {
+        int node = annotations[instance.jobOrder[i]];
+        ret[i] = (node == 0) ? 0 : nodePosition[node - 1] + 1;
+    }
+    return ret;
+}
+
+SolutionCache::SolutionCache(const std::string& path) {
+    load(path);
+    bool tornTail = false;
+    std::ifstream fs(path, std::ios::binary|std::ios::ate);
+    if (fs && fs.tellg() > 0) {
+        fs.seekg(-1, std::ios::end);
+        tornTail = fs.get() != '\n';
+    }
+    mFile.open(path, std::ios::app|std::ios::out);
+    if (tornTail) {
+        // start on a fresh line, the last append didn't finish
+        mFile << '\n';
+        mFile.flush();
+    }
+}
+
+SolutionCache::~SolutionCache() {
+    flush();
+}
+
+void SolutionCache::load(const std::string& path) {
+    std::ifstream fs(path);
+    std::string line;
+    while (std::getline(fs, line)) {
+        // the entry is followed by the checksum of its text, torn or damaged entries don't match it
+        auto separator = line.rfind(' ');
+        if (separator == std::string::npos) {
+            continue;
+        }
+        std::istringstream tail{line.substr(separator + 1)};
+        uint64_t expected;
+        if (!(tail >> std::hex >> expected) || checksum(line.data(), separator) != expected) {
+            continue;
+        }
+        line.resize(separator);
+        std::istringstream ss{line};
+        uint64_t hash;
+        int length, dimension;
+        if (!(ss >> std::hex >> hash >> std::dec >> length >> dimension) || length <= 0 || dimension <= 0) {
+            continue;
+        }
+        Entry entry;
+        entry.queues.resize(2 * length * dimension);
+        entry.annotations.resize(length);
+        bool valid = true;
+        for (auto& item : entry.queues) {
+            valid = valid && (ss >> item);
+        }
+        for (auto& item : entry.annotations) {
+            valid = valid && (ss >> item) && item >= 0 && item <= length;
+        }
+        std::string extra;
+        if (valid && !(ss >> extra)) {
+            mIndex[hash] = std::move(entry);
+        }
+    }
+}
+
+bool SolutionCache::lookup(const CanonicalInstance& instance, std::vector<int>& annotations) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mIndex.find(instance.hash);
+    if (it == mIndex.end() || it->second.queues != instance.queues) {
+        ++mMisses;
+        return false;
+    }
+    ++mHits;
+    annotations = it->second.annotations;
+    return true;
+}
+
+void SolutionCache::insert(const CanonicalInstance& instance, const std::vector<int>& annotations) {
+    int length = annotations.size();
+    int dimension = instance.queues.size() / 2 / length;
+    std::ostringstream ss;
+    ss << std::hex << instance.hash << std::dec << ' ' << length << ' ' << dimension;
+    for (int item : instance.queues) {
+        ss << ' ' << item;
+    }
+    for (int item : annotations) {
+        ss << ' ' << item;
+    }
+    std::string text = ss.str();
+    ss << ' ' << std::hex << checksum(text.data(), text.size()) << '\n';
+
+    bool full;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Entry entry;
+        entry.queues = instance.queues;
+        entry.annotations = annotations;
+        mIndex[instance.hash] = std::move(entry);
+        mPending += ss.str();
+        full = ++mPendingEntries >= FlushEntries;
+    }
+    if (full) {
+        flush();
+    }
+}
+
+void SolutionCache::flush() {
+    std::string pending;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        pending.swap(mPending);
+        mPendingEntries = 0;
+    }
+    if (pending.empty()) {
+        return;
+    }
+    // lookups and inserts go on while the batch is written
+    std::lock_guard<std::mutex> lock(mFileMutex);
+    mFile << pending;
+    mFile.flush();
+}
+
+std::vector<int> SolutionCache::annotate(const std::vector<int>& queues, int dimension, long* exploredNodes) {
+    auto instance = canonicalize(queues, dimension);
+    std::vector<int> annotations;
+    long explored = 0;
+    if (lookup(instance, annotations)) {
+        annotations = remapAnnotations(instance, annotations);
+    } else {
+        // the instance as given, so a miss labels it exactly like AutoAnnotator without the cache
+        auto autoAnnotator = AutoAnnotator(queues, dimension);
+        annotations = autoAnnotator.annotate();
+        explored = autoAnnotator.getExploredNodes();
+        insert(instance, canonicalAnnotations(instance, annotations));
+    }
+    if (exploredNodes) {
+        *exploredNodes = explored;
+    }
+    return annotations;
+}
+
+long SolutionCache::hits() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mHits;
+}
+
+long SolutionCache::misses() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mMisses;
+}
@@ -0,0 +1,112 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+    Node and job queues with their nodes and jobs sorted.
+
+    Permuting nodes or jobs doesn't change the optimal waste, so every
+    permutation of an instance shares the same canonical form.
+*/
+struct CanonicalInstance {
+    std::vector<int> queues;
+    // nodeOrder[i] is the original index of the i-th canonical node, same for jobs
+    std::vector<int> nodeOrder;
+    std::vector<int> jobOrder;
+    uint64_t hash = 0;
+};
+
+CanonicalInstance canonicalize(const std::vector<int>& queues, int dimension);
+
+/**
+    Maps annotations of the canonical instance back to the original job and node order.
+
+    Annotations are in the annotate format: 0 is unassigned, 'n' is the n-th node.
+*/
+std::vector<int> remapAnnotations(const CanonicalInstance& instance, const std::vector<int>& annotations);
+
+/**
+    Maps annotations of the original instance to the canonical job and node order, the inverse of remapAnnotations().
+*/
+std::vector<int> canonicalAnnotations(const CanonicalInstance& instance, const std::vector<int>& annotations);
+
+/**
+    Persistent cache of optimal annotations for canonical instances.
+
+    Backed by an append-only text file with one "hash length dimension queues... annotations... checksum"
+    line per instance, and an in-memory index built when the cache is opened. The checksum is the
+    FNV-1a hash of the text before it, entries that don't match it (e.g. a last line torn by a crash
+    during append, even one cut inside a number) are ignored and solved again.
+
+    New entries are appended in batches of FlushEntries, outside the lock of the lookups, and on
+    flush() and destruction. A crash loses at most the last batch, which is solved again.
+
+    Thread safe.
+*/
+class SolutionCache {
+private:
+    struct Entry {
+        std::vector<int> queues;
+        std::vector<int> annotations;
+    };
+
+    // entries per append to the file
+    static const int FlushEntries = 64;
+
+    std::unordered_map<uint64_t, Entry> mIndex;
+    std::ofstream mFile;
+    // guards everything but mFile
+    std::mutex mMutex;
+    // guards mFile
+    std::mutex mFileMutex;
+    // entries not yet appended to the file
+    std::string mPending;
+    int mPendingEntries = 0;
+    long mHits = 0;
+    long mMisses = 0;
+
+    void load(const std::string& path);
+public:
+    explicit SolutionCache(const std::string& path);
+    ~SolutionCache();
+
+    SolutionCache(const SolutionCache&) = delete;
+    SolutionCache& operator=(const SolutionCache&) = delete;
+
+    /**
+        Looks up the optimal annotations of a canonical instance.
+
+        Returns whether the instance was found.
+    */
+    bool lookup(const CanonicalInstance& instance, std::vector<int>& annotations);
+
+    /**
+        Stores the optimal annotations of a canonical instance in memory, and queues them for the file.
+    */
+    void insert(const CanonicalInstance& instance, const std::vector<int>& annotations);
+
+    /**
+        Appends the queued entries to the file.
+    */
+    void flush();
+
+    /**
+        Returns one optimal annotation of 'queues' in the annotate format.
+
+        Solves 'queues' as given with AutoAnnotator on a miss and stores the result in canonical
+        order, so a queue gets the same annotation with and without the cache. A permutation of
+        a cached queue gets the cached annotation, which is optimal as well but may break ties
+        differently. 'exploredNodes' (if given) is set to the size of the search, 0 on a hit.
+    */
+    std::vector<int> annotate(const std::vector<int>& queues, int dimension, long* exploredNodes = nullptr);
+
+    long hits();
+    long misses();
+};
@@ -0,0 +1,435 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <numeric>
+#include <random>
+#include <sstream>
+
+#include "IntParser.h"
+#include "OctaveBinary.h"
+#include "Trainer.h"
+
+namespace {
+
+// fmincg.m line search constants
+const double RHO = 0.01;
+const double SIG = 0.5;
+const double INT = 0.1;
+const double EXT = 3.0;
+const int MAX = 20;
+const double RATIO = 100;
+
+double dot(const std::vector<double>& a, const std::vector<double>& b) {
+    return std::inner_product(a.begin(), a.end(), b.begin(), 0.);
+}
+
+// x += alpha * y
+void axpy(std::vector<double>& x, double alpha, const std::vector<double>& y) {
+    for (size_t i = 0; i < x.size(); ++i) {
+        x[i] += alpha * y[i];
+    }
+}
+
+}
+
+TrainingSet readTrainingSet(const std::string& path, int length, int dimension, int threads) {
+    ByteMatrix matrix;
+    bool read = isOctaveBinary(path) ? readOctaveRecords(path, matrix) : parseIntMatrix(path, threads, matrix);
+    if (!read) {
+        throw TrainerException("Can't open " + path + ".");
+    }
+    if (!matrix.errors.empty()) {
+        std::ostringstream ss;
+        ss << matrix.errors.size() << " malformed line(s) in " << path << ", first at byte offset "
+           << matrix.errors.front().offset << ".";
+        throw TrainerException(ss.str());
+    }
+    int queueSize = 2 * length * dimension;
+    int labelCount = matrix.columns - queueSize;
+    if (matrix.rows > 0 && labelCount != length && labelCount != length * (length + 1)) {
+        throw TrainerException("Unexpected number of items per line in " + path + ".");
+    }
+
+    TrainingSet ret;
+    ret.length = length;
+    ret.dimension = dimension;
+    ret.size = matrix.rows;
+    ret.samples.resize((size_t)matrix.rows * queueSize);
+    ret.labels.resize((size_t)matrix.rows * length);
+    for (long k = 0; k < matrix.rows; ++k) {
+        const uint8_t* row = matrix.items.data() + k * matrix.columns;
+        std::copy(row, row + queueSize, ret.samples.begin() + k * queueSize);
+        const uint8_t* labels = row + queueSize;
+        for (int i = 0; i < length; ++i) {
+            int label = labels[i];
+            if (labelCount != length) {
+                // one-hot, the first set bit wins
+                const uint8_t* block = labels + i * (length + 1);
+                label = std::find(block, block + (length + 1), 1) - block;
+            }
+            if (label > length) {
+                throw TrainerException("Invalid label in sample " + std::to_string(k + 1) + " of " + path + ".");
+            }
+            ret.labels[k * length + i] = label;
+        }
+    }
+    return ret;
+}
+
+std::vector<double> randomParameters(int inputs, int hidden, int outputs, unsigned seed) {
+    const double epsilon = 0.12;
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> distribution(-epsilon, epsilon);
+    std::vector<double> ret(parameterCount(inputs, hidden, outputs));
+    for (auto& parameter : ret) {
+        parameter = distribution(generator);
+    }
+    return ret;
+}
+
+Network toNetwork(const std::vector<double>& parameters, int length, int dimension, int hidden) {
+    int inputs = featureCount(length, dimension);
+    int outputs = length * (length + 1);
+    if (parameters.size() != parameterCount(inputs, hidden, outputs)) {
+        throw TrainerException("The parameters don't match the network.");
+    }
+    // column major to row major
+    std::vector<double> theta1((size_t)hidden * (inputs + 1));
+    for (int c = 0; c < inputs + 1; ++c) {
+        for (int r = 0; r < hidden; ++r) {
+            theta1[(size_t)r * (inputs + 1) + c] = parameters[(size_t)c * hidden + r];
+        }
+    }
+    const double* unrolled2 = parameters.data() + theta1.size();
+    std::vector<double> theta2((size_t)outputs * (hidden + 1));
+    for (int c = 0; c < hidden + 1; ++c) {
+        for (int r = 0; r < outputs; ++r) {
+            theta2[(size_t)r * (hidden + 1) + c] = unrolled2[(size_t)c * outputs + r];
+        }
+    }
+    return Network(length, dimension, hidden, theta1, theta2);
+}
+
+/**
+    Writes one column major matrix of the unrolled parameters with Octave's text headers.
+*/
+static void writeOctaveMatrix(std::ostream& os, const std::string& name, const double* items, int rows, int columns) {
+    os << "# name: " << name << "\n# type: matrix\n# rows: " << rows << "\n# columns: " << columns << "\n";
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < columns; ++c) {
+            os << " " << items[(size_t)c * rows + r];
+        }
+        os << "\n";
+    }
+    os << "\n\n";
+}
+
+void saveWeights(const std::string& path, const std::vector<double>& parameters, int inputs, int hidden, int outputs) {
+    if (parameters.size() != parameterCount(inputs, hidden, outputs)) {
+        throw TrainerException("The parameters don't match the network.");
+    }
+    std::ofstream fs(path);
+    if (!fs) {
+        throw TrainerException("Can't open " + path + " for writing.");
+    }
+    fs << std::setprecision(17);
+    fs << "# Created by train\n";
+    writeOctaveMatrix(fs, "Theta1", parameters.data(), hidden, inputs + 1);
+    writeOctaveMatrix(fs, "Theta2", parameters.data() + (size_t)hidden * (inputs + 1), outputs, hidden + 1);
+    if (!fs.flush()) {
+        throw TrainerException("Can't write " + path + ".");
+    }
+}
+
+CostFunction::CostFunction(const TrainingSet& set, int hidden, double lambda, int threads)
+: mSet(set), mLayers(featureCount(set.length, set.dimension), hidden, set.length * (set.length + 1)),
+  mLambda(lambda), mThreads(std::max(1, threads)) {
+    // empty
+}
+
+void CostFunction::load(const long* samples, long first, int count, double* inputs, double* targets) const {
+    int length = mSet.length;
+    int sampleSize = 2 * length * mSet.dimension;
+    int block = length + 1;
+    int outputs = mLayers.outputs;
+
+    // A1 = [1 X] and the one-hot y of the compact labels
+    std::fill(targets, targets + (size_t)count * outputs, 0.);
+    for (int r = 0; r < count; ++r) {
+        const uint8_t* sample = mSet.samples.data() + (size_t)samples[first + r] * sampleSize;
+        computeFeatures(sample, 1, length, mSet.dimension, inputs + (size_t)r * (mLayers.inputs + 1) + 1);
+        const uint8_t* labels = mSet.labels.data() + (size_t)samples[first + r] * length;
+        double* row = targets + (size_t)r * outputs;
+        for (int i = 0; i < length; ++i) {
+            row[i * block + labels[i]] = 1;
+        }
+    }
+}
+
+double CostFunction::batch(const std::vector<double>& parameters, const long* samples, long count,
+                           std::vector<double>& gradient) {
+    if (parameters.size() != this->parameters()) {
+        throw TrainerException("The parameters don't match the network.");
+    }
+    count = std::max(0L, count);
+    gradient.resize(parameters.size());
+    double cost = backpropagateParallel(parameters.data(), mLayers, count, mThreads,
+                                        [this, samples](long first, int rows, double* inputs, double* targets) {
+                                            load(samples, first, rows, inputs, targets);
+                                        },
+                                        gradient.data(), mScratch);
+    double scale = 1. / std::max(1L, count);
+    cost *= scale;
+    for (auto& item : gradient) {
+        item *= scale;
+    }
+
+    return cost + regularize(parameters.data(), mLayers, mLambda / std::max(1L, mSet.size), gradient.data());
+}
+
+double CostFunction::operator()(const std::vector<double>& parameters, std::vector<double>& gradient) {
+    std::vector<long> samples(mSet.size);
+    std::iota(samples.begin(), samples.end(), 0L);
+    return batch(parameters, samples.data(), mSet.size, gradient);
+}
+
+double checkGradient(double lambda, int threads, unsigned seed) {
+    // small enough for two cost evaluations per parameter
+    const int length = 3;
+    const int dimension = 2;
+    const int hidden = 5;
+    const long samples = 20;
+    const double epsilon = 1e-4;
+
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<int> resource(0, 20);
+    std::uniform_int_distribution<int> label(0, length);
+    TrainingSet set;
+    set.length = length;
+    set.dimension = dimension;
+    set.size = samples;
+    set.samples.resize((size_t)samples * 2 * length * dimension);
+    set.labels.resize((size_t)samples * length);
+    for (auto& item : set.samples) {
+        item = resource(generator);
+    }
+    for (auto& item : set.labels) {
+        item = label(generator);
+    }
+
+    CostFunction cost(set, hidden, lambda, threads);
+    auto parameters = randomParameters(cost.inputs(), cost.hidden(), cost.outputs(), seed);
+    std::vector<double> analytic;
+    cost(parameters, analytic);
+
+    std::vector<double> numeric(parameters.size());
+    std::vector<double> unused;
+    for (size_t i = 0; i < parameters.size(); ++i) {
+        double parameter = parameters[i];
+        parameters[i] = parameter + epsilon;
+        double plus = cost(parameters, unused);
+        parameters[i] = parameter - epsilon;
+        double minus = cost(parameters, unused);
+        parameters[i] = parameter;
+        numeric[i] = (plus - minus) / (2 * epsilon);
+    }
+
+    double difference = 0;
+    double sum = 0;
+    for (size_t i = 0; i < parameters.size(); ++i) {
+        difference += (numeric[i] - analytic[i]) * (numeric[i] - analytic[i]);
+        sum += (numeric[i] + analytic[i]) * (numeric[i] + analytic[i]);
+    }
+    return std::sqrt(difference) / std::sqrt(sum);
+}
+
+double minimizeConjugateGradient(CostFunction& cost, std::vector<double>& parameters, int iterations,
+                                 const Progress& progress) {
+    std::vector<double>& x = parameters;
+    std::vector<double> df1, df2, x0, df0;
+    double f1 = cost(x, df1);
+    // search direction is steepest
+    std::vector<double> s(df1.size());
+    for (size_t i = 0; i < s.size(); ++i) {
+        s[i] = -df1[i];
+    }
+    double d1 = -dot(s, s);
+    double z1 = 1 / (1 - d1);
+    bool lineSearchFailed = false;
+
+    for (int i = 0; i < iterations; ) {
+        ++i;
+        x0 = x;
+        double f0 = f1;
+        df0 = df1;
+        axpy(x, z1, s);
+        double f2 = cost(x, df2);
+        double d2 = dot(df2, s);
+        // point 3 is point 1
+        double f3 = f1;
+        double d3 = d1;
+        double z3 = -z1;
+        int m = MAX;
+        bool success = false;
+        double limit = -1;
+        for (;;) {
+            while (((f2 > f1 + z1 * RHO * d1) || (d2 > -SIG * d1)) && m > 0) {
+                // tighten the bracket
+                limit = z1;
+                double z2;
+                if (f2 > f1) {
+                    // quadratic fit
+                    z2 = z3 - (0.5 * d3 * z3 * z3) / (d3 * z3 + f2 - f3);
+                } else {
+                    // cubic fit
+                    double a = 6 * (f2 - f3) / z3 + 3 * (d2 + d3);
+                    double b = 3 * (f3 - f2) - z3 * (d3 + 2 * d2);
+                    z2 = (std::sqrt(b * b - a * d2 * z3 * z3) - b) / a;
+                }
+                if (std::isnan(z2) || std::isinf(z2)) {
+                    // numerical problem, bisect
+                    z2 = z3 / 2;
+                }
+                // don't accept too close to the limits
+                z2 = std::max(std::min(z2, INT * z3), (1 - INT) * z3);
+                z1 += z2;
+                axpy(x, z2, s);
+                f2 = cost(x, df2);
+                --m;
+                d2 = dot(df2, s);
+                // z3 is now relative to the location of z2
+                z3 -= z2;
+            }
+            if (f2 > f1 + z1 * RHO * d1 || d2 > -SIG * d1) {
+                break;
+            } else if (d2 > SIG * d1) {
+                success = true;
+                break;
+            } else if (m == 0) {
+                break;
+            }
+            // cubic extrapolation, a negative square root (complex in Octave) is NaN here
+            double a = 6 * (f2 - f3) / z3 + 3 * (d2 + d3);
+            double b = 3 * (f3 - f2) - z3 * (d3 + 2 * d2);
+            double z2 = -d2 * z3 * z3 / (b + std::sqrt(b * b - a * d2 * z3 * z3));
+            if (std::isnan(z2) || std::isinf(z2) || z2 < 0) {
+                // extrapolate the maximum amount without an upper limit, otherwise bisect
+                z2 = (limit < -0.5) ? z1 * (EXT - 1) : (limit - z1) / 2;
+            } else if (limit > -0.5 && z2 + z1 > limit) {
+                z2 = (limit - z1) / 2;
+            } else if (limit < -0.5 && z2 + z1 > z1 * EXT) {
+                z2 = z1 * (EXT - 1);
+            } else if (z2 < -z3 * INT) {
+                z2 = -z3 * INT;
+            } else if (limit > -0.5 && z2 < (limit - z1) * (1 - INT)) {
+                z2 = (limit - z1) * (1 - INT);
+            }
+            // point 3 is point 2
+            f3 = f2;
+            d3 = d2;
+            z3 = -z2;
+            z1 += z2;
+            axpy(x, z2, s);
+            f2 = cost(x, df2);
+            --m;
+            d2 = dot(df2, s);
+        }
+
+        if (success) {
+            f1 = f2;
+            if (progress) {
+                progress(i, f1);
+            }
+            // Polak-Ribiere direction
+            double beta = (dot(df2, df2) - dot(df1, df2)) / dot(df1, df1);
+            for (size_t k = 0; k < s.size(); ++k) {
+                s[k] = beta * s[k] - df2[k];
+            }
+            std::swap(df1, df2);
+            d2 = dot(df1, s);
+            if (d2 > 0) {
+                // the new slope must be negative, otherwise use the steepest direction
+                for (size_t k = 0; k < s.size(); ++k) {
+                    s[k] = -df1[k];
+                }
+                d2 = -dot(s, s);
+            }
+            z1 *= std::min(RATIO, d1 / (d2 - DBL_MIN));
+            d1 = d2;
+            lineSearchFailed = false;
+        } else {
+            // restore the point from before the failed line search
+            x = x0;
+            f1 = f0;
+            df1 = df0;
+            if (lineSearchFailed || i > iterations) {
+                // failed twice in a row, give up
+                break;
+            }
+            // like fmincg.m, try the steepest direction of the last evaluated point
+            std::swap(df1, df2);
+            for (size_t k = 0; k < s.size(); ++k) {
+                s[k] = -df1[k];
+            }
+            d1 = -dot(s, s);
+            z1 = 1 / (1 - d1);
+            lineSearchFailed = true;
+        }
+    }
+    return f1;
+}
+
+double minimizeMiniBatch(CostFunction& cost, std::vector<double>& parameters, const DescentOptions& options,
+                         const Progress& progress) {
+    const double beta1 = 0.9;
+    const double beta2 = 0.999;
+    const double epsilon = 1e-8;
+
+    std::vector<double> gradient;
+    std::vector<double> moment(parameters.size(), 0);
+    std::vector<double> secondMoment(parameters.size(), 0);
+    std::mt19937 generator(options.seed);
+    long size = cost.samples();
+    std::vector<long> order(size);
+    std::iota(order.begin(), order.end(), 0L);
+    int batchSize = std::max(1, options.batchSize);
+    long step = 0;
+    double epochCost = 0;
+
+    for (int epoch = 1; epoch <= options.epochs; ++epoch) {
+        std::shuffle(order.begin(), order.end(), generator);
+        epochCost = 0;
+        long batches = 0;
+        for (long first = 0; first < size; first += batchSize) {
+            long count = std::min((long)batchSize, size - first);
+            epochCost += cost.batch(parameters, order.data() + first, count, gradient);
+            ++batches;
+            ++step;
+            if (options.method == DescentMethod::SGD) {
+                for (size_t i = 0; i < parameters.size(); ++i) {
+                    moment[i] = options.momentum * moment[i] - options.rate * gradient[i];
+                    parameters[i] += moment[i];
+                }
+                continue;
+            }
+            double correction1 = 1 - std::pow(beta1, (double)step);
+            double correction2 = 1 - std::pow(beta2, (double)step);
+            for (size_t i = 0; i < parameters.size(); ++i) {
+                double g = gradient[i];
+                moment[i] = beta1 * moment[i] + (1 - beta1) * g;
+                secondMoment[i] = beta2 * secondMoment[i] + (1 - beta2) * g * g;
+                parameters[i] -= options.rate * (moment[i] / correction1)
+                                 / (std::sqrt(secondMoment[i] / correction2) + epsilon);
+            }
+        }
+        epochCost /= std::max(1L, batches);
+        if (progress) {
+            progress(epoch, epochCost);
+        }
+    }
+    return epochCost;
+}
@@ -0,0 +1,152 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#pragma once
+
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Backpropagation.h"
+#include "Network.h"
+
+class TrainerException : public std::exception {
+private:
+    std::string m_message;
+public:
+    TrainerException(const std::string& message) : m_message(message) {
+        // empty
+    }
+
+    virtual const char* what() const noexcept {
+        return m_message.c_str();
+    }
+};
+
+/**
+    Samples and their compact labels (0 means unassigned, 'n' is the n-th node), one byte per item.
+
+    Features are computed per batch while training, so a sample takes 2 * length * (dimension + 1)
+    bytes of memory instead of a row of doubles.
+*/
+struct TrainingSet {
+    int length = 0;
+    int dimension = 0;
+    long size = 0;
+    // size x (2 * length * dimension)
+    std::vector<uint8_t> samples;
+    // size x length
+    std::vector<uint8_t> labels;
+};
+
+/**
+    Reads a training set with one-hot (train.txt) or compact (annotate --compact) labels,
+    in text or in Octave's binary format (annotate --binary).
+*/
+TrainingSet readTrainingSet(const std::string& path, int length, int dimension, int threads);
+
+/**
+    Number of items of the unrolled parameters [Theta1(:); Theta2(:)].
+*/
+inline size_t parameterCount(int inputs, int hidden, int outputs) {
+    return Layers(inputs, hidden, outputs).parameters();
+}
+
+/**
+    Uniform random parameters in [-0.12, 0.12], like octave/randInitializeWeights.m.
+*/
+std::vector<double> randomParameters(int inputs, int hidden, int outputs, unsigned seed);
+
+/**
+    Builds the inference network from unrolled parameters.
+*/
+Network toNetwork(const std::vector<double>& parameters, int length, int dimension, int hidden);
+
+/**
+    Saves Theta1 and Theta2 in the Octave text format, readable by Network::load() and Octave's load.
+*/
+void saveWeights(const std::string& path, const std::vector<double>& parameters, int inputs, int hidden, int outputs);
+
+/**
+    The cost of octave/nnCostFunction.m: sigmoid cross-entropy over every output plus the
+    lambda regularization of the non-bias weights, and its gradient.
+
+    Parameters and gradients use the same unrolled layout as Octave, see Layers.
+
+    The passes run on every thread with backpropagateParallel(), the result only depends on the
+    number of threads.
+*/
+class CostFunction {
+private:
+    const TrainingSet& mSet;
+    Layers mLayers;
+    double mLambda;
+    int mThreads;
+    ParallelScratch mScratch;
+
+    void load(const long* samples, long first, int count, double* inputs, double* targets) const;
+public:
+    CostFunction(const TrainingSet& set, int hidden, double lambda, int threads);
+
+    long samples() const {return mSet.size;}
+    int inputs() const {return mLayers.inputs;}
+    int hidden() const {return mLayers.hidden;}
+    int outputs() const {return mLayers.outputs;}
+    size_t parameters() const {return mLayers.parameters();}
+
+    /**
+        Cost and gradient over samples 'samples[0..count)' (indices into the training set).
+
+        The cross-entropy is averaged over the batch, the regularization is lambda / (2 * m) with m
+        the size of the whole set, so mini-batches estimate the cost of the whole set.
+    */
+    double batch(const std::vector<double>& parameters, const long* samples, long count,
+                 std::vector<double>& gradient);
+
+    /**
+        Cost and gradient over the whole set, the same as nnCostFunction.m.
+    */
+    double operator()(const std::vector<double>& parameters, std::vector<double>& gradient);
+};
+
+/**
+    Compares the gradient of CostFunction with central differences on a small random network and
+    training set, like checkNNGradients of the original exercise. Returns the relative difference
+    norm(numeric - analytic) / norm(numeric + analytic).
+*/
+double checkGradient(double lambda, int threads, unsigned seed);
+
+/**
+    Called after every iteration (conjugate gradient) or epoch (mini-batch descent) with its cost.
+*/
+typedef std::function<void(int iteration, double cost)> Progress;
+
+/**
+    Port of octave/fmincg.m: Polak-Ribiere conjugate gradients with a line search satisfying the
+    Wolfe-Powell conditions. Runs at most 'iterations' line searches and returns the final cost.
+*/
+double minimizeConjugateGradient(CostFunction& cost, std::vector<double>& parameters, int iterations,
+                                 const Progress& progress);
+
+enum class DescentMethod {
+    // plain mini-batch gradient descent with momentum
+    SGD,
+    // Adam (Kingma, Ba 2014)
+    Adam
+};
+
+struct DescentOptions {
+    DescentMethod method = DescentMethod::Adam;
+    int epochs = 20;
+    int batchSize = 256;
+    double rate = 0.001;
+    double momentum = 0.9;
+    unsigned seed = 0;
+};
+
+/**
+    Mini-batch descent over shuffled batches. Returns the mean batch cost of the last epoch.
+*/
+double minimizeMiniBatch(CostFunction& cost, std::vector<double>& parameters, const DescentOptions& options,
+                         const Progress& progress);
@@ -10,10 +10,13 @@
 #include <iterator>
 #include <iomanip>
 #include <exception>
+#include <chrono>
 
 #include "cxxopts.hpp"
 
 #include "AutoAnnotator.h"
+#include "Dataset.h"
+#include "SolutionCache.h"
 
 /**
     Handles command line options.
@@ -21,9 +24,12 @@
 class Options {
 private:
     std::string mPath;
+    std::string mCachePath;
     int mDimension = 2;
     bool mAuto = false;
     bool mCompact = false;
+    bool mBinary = false;
+    bool mQuiet = false;
     bool mHelp = false;    
     cxxopts::Options options;
     void ensureConsistency() {
@@ -31,6 +37,9 @@ private:
         if (mPath.length() == 0) {
             throw cxxopts::OptionException("Path can't be empty.");
         }
+        if (mQuiet && !mAuto) {
+            throw cxxopts::OptionException("Quiet mode needs --auto.");
+        }
     }
 public:
     Options() : options("annotate", "Online bin packing annotator for creating training sets") {
@@ -40,6 +49,10 @@ public:
           ("d,dim", "Dimension of the items (default: 2)", cxxopts::value<int>(mDimension))
           ("a,auto", "Automatically find one optiomal solution (exponential runtime!)", cxxopts::value<bool>(mAuto))
           ("c,compact", "Annotation is in compact vector form instead of boolean vector form. (default: false)", cxxopts::value<bool>(mCompact))
+          ("binary", "Writes Octave's binary format (the transpose XY_t, a byte per item) instead of text (default: false)",
+                cxxopts::value<bool>(mBinary))
+          ("q,quiet", "Annotates every input line without rendering, prints \"instance time_us explored waste\" per line (needs --auto)", cxxopts::value<bool>(mQuiet))
+          ("cache", "Persistent cache of optimal solutions used by --auto (default: none)", cxxopts::value<std::string>(mCachePath))
           ("h,help", "Prints help", cxxopts::value<bool>(mHelp))
         ;
     }
@@ -54,17 +67,23 @@ public:
         return true;
     }
     std::string getPath() const {return mPath;}
+    std::string getCachePath() const {return mCachePath;}
     int getDimension() const {return mDimension;}
     bool isAuto() const {return mAuto;}
     bool isCompact() const {return mCompact;}
+    DatasetFormat getFormat() const {return mBinary ? DatasetFormat::OctaveBinary : DatasetFormat::Text;}
+    bool isQuiet() const {return mQuiet;}
     bool isHelp() const {return mHelp;}
     std::string helpMessage() const {return options.help({""});}
     void print() const {
         std::cout << "options = {" 
                   << "\n  file: " << mPath
+                  << ",\n  cache: " << mCachePath
                   << ",\n  dimension: " << mDimension
                   << ",\n  auto: " << mAuto
                   << ",\n  compact: " << mCompact
+                  << ",\n  binary: " << mBinary
+                  << ",\n  quiet: " << mQuiet
                   << ",\n  help: " << mHelp
                   << "\n}" << std::endl;
     }
@@ -84,14 +103,10 @@ public:
 };
 
 /**
-    Reads input from cmd line in the format of "[int, int, ...]"
-
-    Returns an std::vector<int>
+    Parses one line in the format of "[int, int, ...]"
 */
-std::vector<int> readInput() {
+std::vector<int> parseInput(const std::string& line) {
     std::vector<int> v;
-    std::string line;
-    std::getline(std::cin, line);
     std::istringstream ss{line};
     char c;
     ss >> c;
@@ -110,6 +125,17 @@ std::vector<int> readInput() {
     return v;
 }
 
+/**
+    Reads input from cmd line in the format of "[int, int, ...]"
+
+    Returns an std::vector<int>
+*/
+std::vector<int> readInput() {
+    std::string line;
+    std::getline(std::cin, line);
+    return parseInput(line);
+}
+
 /**
     Pretty prints one queue.
 
@@ -216,39 +242,81 @@ std::vector<int> annotate(int length) {
 }
 
 /**
-    Transforms a mathematical vector to a bool vector.
-
-    Example:
-    func([2, 3], 4) -> [0, 0, 1, 0, 0, 0, 0, 0, 1, 0]
+    Pretty prints the annotations, the same way as AutoAnnotator::printDistribution().
 */
-std::vector<int> vectorToBoolVector(const std::vector<int>& vec, int length) {
-    auto size = vec.size();
-    std::vector<int> ret(size * length, 0);
-    for (int i = 0; i < size; ++i) {
-        ret[length * i + vec[i]] = 1;
+void printAnnotations(const std::vector<int>& annotations) {
+    for (size_t i = 0; i < annotations.size(); ++i) {
+        std::cout << "\nJob " << (i + 1) << ". : " << annotations[i] << "\n";
     }
-    return ret;
 }
 
 /**
     Appends the queues and it's annotations to the file specified by the 'file' cmd line option.
+
+    The write is fsync-ed and recorded in the file's manifest, see DatasetWriter.
+*/
+void writeToFile(const std::string& path, DatasetFormat format, const std::vector<int>& queues,
+                 const std::vector<int>& annotations) {
+    DatasetWriter writer(path, "annotate", 1, 1, format);
+    writer.write(0, queues, annotations);
+}
+
+/**
+    Sum of the resources of the unassigned jobs.
 */
-void writeToFile(const std::string& path, const std::vector<int>& queues, const std::vector<int>& annotations) {
-    auto fs = std::ofstream(path, std::ios::app|std::ios::out);
-    bool notFirst = false;
-    for (auto it = queues.cbegin(); it != queues.cend(); ++it) {
-        if (notFirst) {
-            fs << " ";
+int calculateWaste(const std::vector<int>& queues, const std::vector<int>& annotations, int dimension) {
+    int length = annotations.size();
+    int waste = 0;
+    for (int i = 0; i < length; ++i) {
+        if (annotations[i] == 0) {
+            for (int d = 0; d < dimension; ++d) {
+                waste += queues[length * dimension + i * dimension + d];
+            }
         }
-        fs << *it;
-        notFirst = true;
     }
+    return waste;
+}
 
-    for (auto it = annotations.cbegin(); it != annotations.cend(); ++it) {        
-        fs << ' ' << *it;        
+/**
+    Auto annotates every input line without any rendering.
+
+    Prints one "instance time_us explored waste" line per input line, where 'explored'
+    is the number of visited search tree nodes (0 for solution cache hits).
+*/
+void annotateStream(const Options& opts) {
+    int dim = opts.getDimension();
+    std::unique_ptr<SolutionCache> cache;
+    if (opts.getCachePath().length() > 0) {
+        cache.reset(new SolutionCache(opts.getCachePath()));
     }
+    DatasetWriter writer(opts.getPath(), "annotate", 1, 256, opts.getFormat());
 
-    fs << "\n";
+    std::cout << "# instance time_us explored waste\n";
+    std::string line;
+    long instance = 0;
+    while (std::getline(std::cin, line)) {
+        if (line.find('[') == std::string::npos) {
+            continue;
+        }
+        auto queues = parseInput(line);
+        auto start = std::chrono::steady_clock::now();
+        std::vector<int> annotations;
+        long explored = 0;
+        if (cache) {
+            annotations = cache->annotate(queues, dim, &explored);
+        } else {
+            auto autoAnnotator = AutoAnnotator(queues, dim);
+            annotations = autoAnnotator.annotate();
+            explored = autoAnnotator.getExploredNodes();
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        int waste = calculateWaste(queues, annotations, dim);
+        if (!opts.isCompact()) {
+            annotations = vectorToBoolVector(annotations, annotations.size() + 1);
+        }
+        writer.write(0, queues, annotations);
+        std::cout << ++instance << ' ' << elapsed.count() << ' ' << explored << ' ' << waste << '\n';
+    }
 }
 
 int main(int argc, char* argv[]) {
@@ -262,10 +330,23 @@ int main(int argc, char* argv[]) {
         return 0;
     }
     // opts.print();
+    if (opts.isQuiet()) {
+        try {
+            annotateStream(opts);
+        } catch(const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
     auto queues = readInput();
     prettyPrintQueues(queues, opts);
     std::vector<int> annotations;
-    if (opts.isAuto()) {
+    if (opts.isAuto() && opts.getCachePath().length() > 0) {
+        SolutionCache cache(opts.getCachePath());
+        annotations = cache.annotate(queues, opts.getDimension());
+        printAnnotations(annotations);
+    } else if (opts.isAuto()) {
         auto autoAnnotator = AutoAnnotator(queues, opts.getDimension());
         annotations = autoAnnotator.annotate();
         autoAnnotator.printDistribution();
@@ -275,7 +356,12 @@ int main(int argc, char* argv[]) {
     if (!opts.isCompact()) {
         annotations = vectorToBoolVector(annotations, queues.size() / 2 / opts.getDimension() + 1);
     }
-    writeToFile(opts.getPath(), queues, annotations);
+    try {
+        writeToFile(opts.getPath(), opts.getFormat(), queues, annotations);
+    } catch(const DatasetException& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
     return 0;
 }
 
@@ -0,0 +1,359 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <vector>
+#include <exception>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <memory>
+#include <numeric>
+
+#include "cxxopts.hpp"
+
+#include "AutoAnnotator.h"
+#include "Dataset.h"
+#include "Generator.h"
+#include "RingBuffer.h"
+#include "SolutionCache.h"
+
+/**
+    Handles command line options.
+*/
+class Options {
+private:
+    std::string mPath;
+    std::string mSchedulePath;
+    std::string mCachePath;
+    int mLength = 12;
+    int mDimension = 2;
+    int mWorkers = 0;
+    int mGenerators = 1;
+    int mBatchSize = 256;
+    bool mCompact = false;
+    bool mBinary = false;
+    bool mHelp = false;
+    cxxopts::Options options;
+    void ensureConsistency() {
+        mLength = std::max(1, mLength);
+        mDimension = std::max(1, mDimension);
+        mGenerators = std::max(1, mGenerators);
+        mBatchSize = std::max(1, mBatchSize);
+        if (mWorkers <= 0) {
+            mWorkers = std::max(1u, std::thread::hardware_concurrency());
+        }
+        if (mPath.length() == 0) {
+            throw cxxopts::OptionException("Path can't be empty.");
+        }
+        if (mSchedulePath.length() == 0) {
+            throw cxxopts::OptionException("Path to schedule can't be empty.");
+        }
+    }
+public:
+    Options() : options("build_dataset", "Generates and auto annotates a whole training set") {
+        options.add_options()
+          ("f,file", "Results are appended to this file", cxxopts::value<std::string>(mPath)
+                ->default_value("train.txt"))
+          ("s,schedule", "Ratio schedule, lines of \"ratio count\"", cxxopts::value<std::string>(mSchedulePath)
+                ->default_value("schedule.txt"))
+          ("cache", "Persistent cache of optimal solutions (default: none)", cxxopts::value<std::string>(mCachePath))
+          ("l,length", "Length of the queues (default: 12)", cxxopts::value<int>(mLength))
+          ("d,dim", "Dimension of the items (default: 2)", cxxopts::value<int>(mDimension))
+          ("w,workers", "Number of annotator threads (default: number of cores)", cxxopts::value<int>(mWorkers))
+          ("g,generators", "Number of generator threads (default: 1)", cxxopts::value<int>(mGenerators))
+          ("b,batch", "Number of records written and fsync-ed together (default: 256)", cxxopts::value<int>(mBatchSize))
+          ("c,compact", "Annotation is in compact vector form instead of boolean vector form. (default: false)", cxxopts::value<bool>(mCompact))
+          ("binary", "Writes Octave's binary format (the transpose XY_t, a byte per item) instead of text (default: false)",
+                cxxopts::value<bool>(mBinary))
+          ("h,help", "Prints help", cxxopts::value<bool>(mHelp))
+        ;
+    }
+    bool parseCMDLine(int argc, char* argv[]) {
+        try {
+            options.parse(argc, argv);
+            ensureConsistency();
+        } catch(const cxxopts::OptionException& e) {
+            std::cerr << "error parsing options: " << e.what() << std::endl;
+            return false;
+        }
+        return true;
+    }
+    std::string getPath() const {return mPath;}
+    std::string getSchedulePath() const {return mSchedulePath;}
+    std::string getCachePath() const {return mCachePath;}
+    int getLength() const {return mLength;}
+    int getDimension() const {return mDimension;}
+    int getWorkers() const {return mWorkers;}
+    int getGenerators() const {return mGenerators;}
+    int getBatchSize() const {return mBatchSize;}
+    bool isCompact() const {return mCompact;}
+    DatasetFormat getFormat() const {return mBinary ? DatasetFormat::OctaveBinary : DatasetFormat::Text;}
+    bool isHelp() const {return mHelp;}
+    std::string helpMessage() const {return options.help({""});}
+    void print() const {
+        std::cout << "options = {"
+                  << "\n  file: " << mPath
+                  << ",\n  schedule: " << mSchedulePath
+                  << ",\n  cache: " << mCachePath
+                  << ",\n  length: " << mLength
+                  << ",\n  dimension: " << mDimension
+                  << ",\n  workers: " << mWorkers
+                  << ",\n  generators: " << mGenerators
+                  << ",\n  batch: " << mBatchSize
+                  << ",\n  compact: " << mCompact
+                  << ",\n  binary: " << mBinary
+                  << ",\n  help: " << mHelp
+                  << "\n}" << std::endl;
+    }
+};
+
+class BuildException : public std::exception {
+private:
+    std::string m_message;
+public:
+    BuildException(const std::string& message) : m_message(message) {
+        // empty
+    }
+
+    virtual const char* what() const noexcept {
+        return m_message.c_str();
+    }
+};
+
+struct ScheduleEntry {
+    double ratio = 0;
+    int count = 0;
+};
+
+/**
+    Reads the ratio schedule. Empty lines and lines starting with '#' are skipped.
+
+    Sample:
+    "
+    # base
+    0.0 500
+    0.1 500
+    "
+*/
+std::vector<ScheduleEntry> readSchedule(const std::string& path) {
+    std::ifstream fs(path);
+    if (!fs) {
+        throw BuildException("Can't open schedule " + path + ".");
+    }
+    std::vector<ScheduleEntry> ret;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(fs, line)) {
+        ++lineNumber;
+        auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+        std::istringstream ss{line};
+        ScheduleEntry entry;
+        if (!(ss >> entry.ratio >> entry.count)) {
+            throw BuildException("Schedule error in line " + std::to_string(lineNumber) + ".");
+        }
+        entry.ratio = std::min(1., std::max(0., entry.ratio));
+        entry.count = std::max(0, entry.count);
+        ret.push_back(entry);
+    }
+    return ret;
+}
+
+struct Instance {
+    int section = 0;
+    std::vector<int> queues;
+};
+
+struct Record {
+    int section = 0;
+    std::vector<int> queues;
+    std::vector<int> annotations;
+};
+
+/**
+    Generates, annotates and writes out the training set described by the schedule.
+
+    Instances already committed by a previous (interrupted) run are skipped.
+
+    generators -> RingBuffer -> AutoAnnotator workers -> RingBuffer -> writer
+*/
+class Pipeline {
+private:
+    const Options& mOpts;
+    SolutionCache* mCache;
+    DatasetWriter& mWriter;
+    std::vector<ScheduleEntry> mSchedule;
+    // mScheduleEnd[i] is the index one past the last missing instance of entry i
+    std::vector<long> mScheduleEnd;
+    std::atomic<long> mNextInstance;
+    std::atomic<bool> mFailed;
+    RingBuffer<Instance> mInstances;
+    RingBuffer<Record> mRecords;
+    long mWritten = 0;
+
+    long total() const {
+        return mScheduleEnd.empty() ? 0 : mScheduleEnd.back();
+    }
+
+    void generateInstances(unsigned seed) {
+        auto generator = Generator(mOpts.getLength(), mOpts.getDimension(), seed);
+        for (;;) {
+            long instance = mNextInstance.fetch_add(1, std::memory_order_relaxed);
+            if (instance >= total() || mFailed.load(std::memory_order_relaxed)) {
+                return;
+            }
+            Instance item;
+            item.section = std::upper_bound(mScheduleEnd.begin(), mScheduleEnd.end(), instance) - mScheduleEnd.begin();
+            item.queues = generator.generate(mSchedule[item.section].ratio);
+            mInstances.push(std::move(item));
+        }
+    }
+
+    void annotateInstances() {
+        Instance item;
+        while (mInstances.pop(item)) {
+            const auto& queues = item.queues;
+            Record record;
+            record.section = item.section;
+            if (mCache) {
+                record.annotations = mCache->annotate(queues, mOpts.getDimension());
+            } else {
+                auto autoAnnotator = AutoAnnotator(queues, mOpts.getDimension());
+                record.annotations = autoAnnotator.annotate();
+            }
+            if (!mOpts.isCompact()) {
+                record.annotations = vectorToBoolVector(record.annotations, mOpts.getLength() + 1);
+            }
+            record.queues = std::move(item.queues);
+            mRecords.push(std::move(record));
+        }
+    }
+
+    void writeRecords() {
+        auto lastReport = std::chrono::steady_clock::now();
+        Record record;
+        while (mRecords.pop(record)) {
+            if (mFailed.load(std::memory_order_relaxed)) {
+                continue;
+            }
+            try {
+                mWriter.write(record.section, record.queues, record.annotations);
+            } catch (const DatasetException& e) {
+                std::cerr << "\n" << e.what() << std::endl;
+                mFailed.store(true, std::memory_order_relaxed);
+                continue;
+            }
+            ++mWritten;
+            auto now = std::chrono::steady_clock::now();
+            if (now - lastReport > std::chrono::seconds(1)) {
+                std::cerr << "\r" << mWritten << " / " << total() << std::flush;
+                lastReport = now;
+            }
+        }
+        try {
+            mWriter.commit();
+        } catch (const DatasetException& e) {
+            std::cerr << "\n" << e.what() << std::endl;
+            mFailed.store(true, std::memory_order_relaxed);
+        }
+        std::cerr << "\r" << mWritten << " / " << total() << std::endl;
+    }
+public:
+    Pipeline(const Options& opts, SolutionCache* cache, DatasetWriter& writer, const std::vector<ScheduleEntry>& schedule)
+    : mOpts(opts), mCache(cache), mWriter(writer), mSchedule(schedule), mNextInstance(0), mFailed(false),
+      mInstances(4 * opts.getWorkers() + 16), mRecords(4 * opts.getWorkers() + 16) {
+        long end = 0;
+        for (size_t i = 0; i < mSchedule.size(); ++i) {
+            end += std::max(0L, mSchedule[i].count - mWriter.progress()[i]);
+            mScheduleEnd.push_back(end);
+        }
+    }
+
+    bool failed() const {return mFailed.load();}
+
+    /**
+        Runs the whole pipeline.
+
+        Returns the number of newly written instances.
+    */
+    long run() {
+        std::random_device rd;
+        std::vector<std::thread> generators;
+        for (int i = 0; i < mOpts.getGenerators(); ++i) {
+            generators.emplace_back(&Pipeline::generateInstances, this, rd());
+        }
+        std::vector<std::thread> workers;
+        for (int i = 0; i < mOpts.getWorkers(); ++i) {
+            workers.emplace_back(&Pipeline::annotateInstances, this);
+        }
+        std::thread writer(&Pipeline::writeRecords, this);
+
+        for (auto& t : generators) {
+            t.join();
+        }
+        mInstances.close();
+        for (auto& t : workers) {
+            t.join();
+        }
+        mRecords.close();
+        writer.join();
+        return mWritten;
+    }
+};
+
+int main(int argc, char* argv[]) {
+    Options opts;
+    if (!opts.parseCMDLine(argc, argv)) {
+        return 1;
+    }
+    if (opts.isHelp())
+    {
+        std::cout << opts.helpMessage() << std::endl;
+        return 0;
+    }
+    // opts.print();
+    std::vector<ScheduleEntry> schedule;
+    try {
+        schedule = readSchedule(opts.getSchedulePath());
+    } catch(const BuildException& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<SolutionCache> cache;
+    if (opts.getCachePath().length() > 0) {
+        cache.reset(new SolutionCache(opts.getCachePath()));
+    }
+
+    std::unique_ptr<DatasetWriter> writer;
+    try {
+        writer.reset(new DatasetWriter(opts.getPath(), "build_dataset", schedule.size(), opts.getBatchSize(),
+                                       opts.getFormat()));
+    } catch(const DatasetException& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    long done = std::accumulate(writer->progress().begin(), writer->progress().end(), 0L);
+    if (done > 0) {
+        std::cout << "Resuming, " << done << " instances are already in " << opts.getPath() << "." << std::endl;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Pipeline pipeline(opts, cache.get(), *writer, schedule);
+    long written = pipeline.run();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << "Annotated " << written << " instances in " << elapsed.count() << " s ("
+              << written / std::max(elapsed.count(), 1e-9) << " instances/s) using "
+              << opts.getWorkers() << " workers." << std::endl;
+    if (cache) {
+        std::cout << "Solution cache: " << cache->hits() << " hits, " << cache->misses() << " misses." << std::endl;
+    }
+    return pipeline.failed() ? 1 : 0;
+}
@@ -12,18 +12,62 @@
 #include <numeric>
 #include <iterator>
 #include <iomanip>
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include <glob.h>
 
 #include "cxxopts.hpp"
 
+#include "BaselineFile.h"
+#include "BatchFirstFit.h"
+#include "Heuristics.h"
+#include "IntParser.h"
+#include "Network.h"
+#include "OctaveBinary.h"
+
+/**
+    Expands the glob patterns among 'patterns', in sorted order. Other paths are kept as they are.
+*/
+std::vector<std::string> expandPaths(const std::vector<std::string>& patterns) {
+    std::vector<std::string> ret;
+    for (const auto& pattern : patterns) {
+        glob_t matches;
+        if (::glob(pattern.c_str(), GLOB_NOCHECK, nullptr, &matches) != 0) {
+            ret.push_back(pattern);
+            continue;
+        }
+        for (size_t i = 0; i < matches.gl_pathc; ++i) {
+            ret.push_back(matches.gl_pathv[i]);
+        }
+        ::globfree(&matches);
+    }
+    return ret;
+}
+
+// Node indices are stored in one byte.
+const int MaxLength = 255;
+
 /**
     Handles command line options.
 */
 class Options {
 private:
     std::string mPathTr;
-    std::string mPathPr;
+    std::vector<std::string> mPathsPr;
+    std::string mBaselinePath;
+    std::string mWeightsPath;
+    std::string mModelPath;
     int mDimension = 0;
     int mLength = 0;
+    int mThreads = 0;
+    bool mStream = false;
+    bool mNoBaseline = false;
+    bool mInt8 = false;
+    bool mRepair = false;
+    bool mSession = false;
     bool mHelp = false;    
     cxxopts::Options options;
     void ensureConsistency() {
@@ -36,22 +80,60 @@ private:
         if (mLength == 0) {
             throw cxxopts::OptionException("Please add the set's queue length.");
         }
+        if (mLength > MaxLength) {
+            throw cxxopts::OptionException("The queue length can't be more than " + std::to_string(MaxLength) + ".");
+        }
         if (mPathTr.length() == 0) {
             throw cxxopts::OptionException("Path to training set can't be empty.");
         }
-        if (mPathPr.length() == 0) {
-            throw cxxopts::OptionException("Path to predicted solutions can't be empty.");
+        if (mPathsPr.empty() && mWeightsPath.length() == 0) {
+            throw cxxopts::OptionException("Path to predicted solutions or to network weights can't be empty.");
+        }
+        mPathsPr = expandPaths(mPathsPr);
+        if (mInt8 && mWeightsPath.length() == 0) {
+            throw cxxopts::OptionException("--int8 needs the network weights (-w).");
+        }
+        if (mSession && (mWeightsPath.length() == 0 || mStream)) {
+            throw cxxopts::OptionException("--session needs the network weights (-w) and doesn't work with --stream.");
+        }
+        if (mRepair && mWeightsPath.length() == 0) {
+            throw cxxopts::OptionException("--repair needs the network weights (-w).");
+        }
+        if (mModelPath.length() > 0 && mWeightsPath.length() == 0) {
+            throw cxxopts::OptionException("--save_model needs the network weights (-w).");
+        }
+        if (mBaselinePath.length() == 0) {
+            mBaselinePath = mPathTr + ".baseline";
+        }
+        if (mThreads <= 0) {
+            mThreads = std::max(1u, std::thread::hardware_concurrency());
         }
     }
 public:
     Options() : options("evaluate", "Compares given algorithm result to the First Fit algorithm.") {
         options.add_options()
           ("t,file_tr", "Training set file with optimal solutions", cxxopts::value<std::string>(mPathTr))
-          ("p,file_pr", "Predicted solutions", cxxopts::value<std::string>(mPathPr))
+          ("p,file_pr", "Predicted solutions, repeatable, quoted globs are expanded (also: trailing arguments)",
+                cxxopts::value<std::vector<std::string>>(mPathsPr))
           ("d,dim", "Dimension of the items (required)", cxxopts::value<int>(mDimension))
           ("l,length", "Length of the queues (required)", cxxopts::value<int>(mLength))
+          ("j,threads", "Number of threads (default: number of cores)", cxxopts::value<int>(mThreads))
+          ("s,stream", "Reads the files in lockstep with constant memory use (default: false)", cxxopts::value<bool>(mStream))
+          ("w,weights", "Evaluates the network in this file (Theta1 and Theta2 saved by octave/main.m, or a model file) as well",
+                cxxopts::value<std::string>(mWeightsPath))
+          ("save_model", "Saves the network of -w as a memory mappable model file, float and int8 weights",
+                cxxopts::value<std::string>(mModelPath))
+          ("int8", "Evaluates the int8 quantized network next to the float one (default: false)", cxxopts::value<bool>(mInt8))
+          ("session", "Replays the samples through an online InferenceSession and compares it with the network (default: false)",
+                cxxopts::value<bool>(mSession))
+          ("repair", "Jobs of the networks which don't fit on their node go to the next best scoring one (default: false)",
+                cxxopts::value<bool>(mRepair))
+          ("baseline", "Sidecar with the baseline wastes of the training set (default: <file_tr>.baseline)",
+                cxxopts::value<std::string>(mBaselinePath))
+          ("no_baseline", "Neither reads nor writes the baseline sidecar (default: false)", cxxopts::value<bool>(mNoBaseline))
           ("h,help", "Prints help", cxxopts::value<bool>(mHelp))
         ;
+        options.parse_positional("file_pr");
     }
     bool parseCMDLine(int argc, char* argv[]) {
         try {
@@ -64,298 +146,750 @@ public:
         return true;
     }
     std::string getPathTr() const {return mPathTr;}
-    std::string getPathPr() const {return mPathPr;}
+    const std::vector<std::string>& getPathsPr() const {return mPathsPr;}
     int getDimension() const {return mDimension;}
     int getLength() const {return mLength;}
+    int getThreads() const {return mThreads;}
+    std::string getBaselinePath() const {return mBaselinePath;}
+    std::string getWeightsPath() const {return mWeightsPath;}
+    std::string getModelPath() const {return mModelPath;}
+    bool isStream() const {return mStream;}
+    bool useBaseline() const {return !mNoBaseline;}
+    bool isInt8() const {return mInt8;}
+    bool isRepair() const {return mRepair;}
+    bool isSession() const {return mSession;}
     bool isHelp() const {return mHelp;}
     std::string helpMessage() const {return options.help({""});}
     void print() const {
         std::cout << "options = {" 
                   << "\n  file_tr: " << mPathTr
-                  << ",\n  file_pr: " << mPathPr
+                  << ",\n  file_pr: " << mPathsPr.size() << " file(s)"
                   << ",\n  dimension: " << mDimension
                   << ",\n  length: " << mLength
+                  << ",\n  threads: " << mThreads
+                  << ",\n  stream: " << mStream
+                  << ",\n  weights: " << mWeightsPath
+                  << ",\n  save_model: " << mModelPath
+                  << ",\n  int8: " << mInt8
+                  << ",\n  repair: " << mRepair
+                  << ",\n  session: " << mSession
+                  << ",\n  baseline: " << mBaselinePath
+                  << ",\n  no_baseline: " << mNoBaseline
                   << ",\n  help: " << mHelp
                   << "\n}" << std::endl;
     }
 };
 
-std::vector<int> readInput(const std::string& path, int totalLength) {
-    std::vector<int> ret;
-    auto fs = std::ifstream(path, std::ios::in);
-    std::string line;
-    while (std::getline(fs, line)) {
-        std::istringstream ss{line};
-        int input;
-        for (int i = 0; i < totalLength; ++i) {
-            if (ss >> input) {
-                ret.push_back(input);
+class EvaluateException : public std::exception {
+private:
+    std::string m_message;
+public:
+    EvaluateException(const std::string& message) : m_message(message) {
+        // empty
+    }
+
+    virtual const char* what() const noexcept {
+        return m_message.c_str();
+    }
+};
+
+/**
+    Samples read from a training set or from a prediction file.
+
+    Resources take one byte each and labels are stored in compact form, one byte node index per job
+    (0 means unassigned), regardless of the encoding used in the file. A sample of length 12 and
+    dimension 2 takes 60 bytes instead of the 816 bytes of its one-hot text form parsed into ints.
+*/
+struct Samples {
+    // 2 * length * dimension items per sample, empty for prediction files
+    std::vector<uint8_t> queues;
+    // length items per sample
+    std::vector<uint8_t> labels;
+    int size = 0;
+
+    void clear() {
+        queues.clear();
+        labels.clear();
+        size = 0;
+    }
+};
+
+// Resources are stored in one byte.
+const int MaxResource = 255;
+
+/**
+    Appends one line of 'queueSize' resources followed by 'labelCount' labels to 'samples'.
+
+    'labelCount' is either 'length' (compact) or length * (length + 1) (one-hot).
+    Returns false if a resource or a compact label is out of range.
+*/
+template <typename T>
+bool appendSample(const T* items, int queueSize, int labelCount, int length, Samples& samples) {
+    for (int i = 0; i < queueSize; ++i) {
+        if (items[i] < 0 || items[i] > MaxResource) {
+            return false;
+        }
+        samples.queues.push_back(items[i]);
+    }
+    const T* labels = items + queueSize;
+    if (labelCount == length) {
+        for (int i = 0; i < length; ++i) {
+            if (labels[i] < 0 || labels[i] > length) {
+                return false;
             }
+            samples.labels.push_back(labels[i]);
+        }
+    } else {
+        // one-hot, the first set bit wins
+        for (int i = 0; i < length; ++i) {
+            const T* block = labels + i * (length + 1);
+            const T* hot = std::find(block, block + (length + 1), 1);
+            samples.labels.push_back(hot == block + (length + 1) ? 0 : hot - block);
+        }
+    }
+    ++samples.size;
+    return true;
+}
+
+bool isValidLabelCount(int labelCount, int length) {
+    return labelCount == length || labelCount == length * (length + 1);
+}
+
+/**
+    Reads a training set ('queueSize' = 2 * length * dimension) or a prediction file ('queueSize' = 0).
+
+    Each line holds 'queueSize' resources and then the labels, either as one-hot blocks of
+    (length + 1) ints per job or as one node index per job (annotate --compact).
+    The file is parsed in parallel (see parseIntMatrix), malformed lines are reported by byte offset.
+    Every value is parsed straight into a byte, the matrix is only kept until it is packed into Samples.
+    Binary training sets (annotate --binary) are read as they are, see readOctaveRecords().
+*/
+Samples readInput(const std::string& path, int queueSize, int length, int threads) {
+    ByteMatrix matrix;
+    bool read = isOctaveBinary(path) ? readOctaveRecords(path, matrix) : parseIntMatrix(path, threads, matrix);
+    if (!read) {
+        throw EvaluateException("Can't open " + path + ".");
+    }
+    if (!matrix.errors.empty()) {
+        std::ostringstream ss;
+        ss << matrix.errors.size() << " malformed line(s) in " << path << ", first at byte offset "
+           << matrix.errors.front().offset << ".";
+        throw EvaluateException(ss.str());
+    }
+    int labelCount = matrix.columns - queueSize;
+    if (matrix.rows > 0 && !isValidLabelCount(labelCount, length)) {
+        throw EvaluateException("Unexpected number of items per line in " + path + ".");
+    }
+
+    Samples ret;
+    ret.queues.reserve((size_t)matrix.rows * queueSize);
+    ret.labels.reserve((size_t)matrix.rows * length);
+    for (long k = 0; k < matrix.rows; ++k) {
+        const uint8_t* row = matrix.items.data() + k * matrix.columns;
+        if (!appendSample(row, queueSize, labelCount, length, ret)) {
+            throw EvaluateException("Value out of range in sample " + std::to_string(k + 1) + " of " + path + ".");
         }
     }
     return ret;
 }
 
-std::vector<int> wasteForOptimum(const std::vector<int>& queues, int length, int dimension) {    
-    int sampleMargin = 2 * length * dimension + length * (length + 1);
-    int assignmentMargin = 2 * length * dimension;
-    int sampleSize = queues.size() / sampleMargin;
-    std::vector<int> ret;
-    ret.reserve(sampleSize);
-    // samples
-    for (int k = 0; k < sampleSize; ++k) {
-        int waste = 0;
-        // tasks
-        for (int i = 0; i < length; ++i) {
-            // assigned to Node 0
-            if (queues[sampleMargin * k + assignmentMargin + i * (length + 1)] == 1) {
-                for (int d = 0; d < dimension; ++d) {
-                    waste += queues[sampleMargin * k + length * dimension + i * dimension + d];
-                }
+/**
+    Reads a training set or prediction file one sample at a time (see readInput()).
+*/
+class SampleStream {
+private:
+    std::string mPath;
+    std::ifstream mFile;
+    std::string mLine;
+    std::vector<int> mItems;
+    int mQueueSize;
+    int mLength;
+    long mLineNumber = 0;
+public:
+    SampleStream(const std::string& path, int queueSize, int length)
+    : mPath(path), mFile(path), mQueueSize(queueSize), mLength(length) {
+        if (!mFile) {
+            throw EvaluateException("Can't open " + path + ".");
+        }
+        if (isOctaveBinary(path)) {
+            throw EvaluateException("Streaming needs a text file, " + path + " is binary.");
+        }
+    }
+
+    /**
+        Appends the next sample to 'samples'. Returns false at the end of the file.
+    */
+    bool next(Samples& samples) {
+        while (std::getline(mFile, mLine)) {
+            ++mLineNumber;
+            auto first = mLine.find_first_not_of(" \t\r");
+            if (first == std::string::npos || mLine[first] == '#') {
+                continue;
             }
+            const char* begin = mLine.data();
+            if (!parseIntLine(begin, begin + mLine.size(), mItems)
+                || !isValidLabelCount((int)mItems.size() - mQueueSize, mLength)
+                || !appendSample(mItems.data(), mQueueSize, mItems.size() - mQueueSize, mLength, samples)) {
+                throw EvaluateException("Malformed line " + std::to_string(mLineNumber) + " in " + mPath + ".");
+            }
+            return true;
         }
-        ret.push_back(waste);
+        return false;
     }
-    return ret;
+};
+
+/**
+    Drops the trailing samples, so that both sets have the same size.
+*/
+void truncate(Samples& samples, int size, int queueSize, int length) {
+    samples.size = size;
+    samples.queues.resize(std::min(samples.queues.size(), (size_t)size * queueSize));
+    samples.labels.resize((size_t)size * length);
 }
 
-std::vector<int> wasteForSet(const std::vector<int>& queues,
-                             const std::vector<int>& prediction,
-                             int length,
-                             int dimension) {
-
-    int sampleMarginInQueue = 2 * length * dimension + length * (length + 1);
-    int sampleMargin = length * (length + 1);
-    int sampleSize = prediction.size() / sampleMargin;
-    std::vector<int> ret;
-    ret.reserve(sampleSize);
-    // samples
-    for (int k = 0; k < sampleSize; ++k) {
-        int waste = 0;
-        // tasks
-        for (int i = 0; i < length; ++i) {
-            // assigned to Node 0
-            if (prediction[sampleMargin * k + i * (length + 1)] == 1) {
+/**
+    Sum of the resources of the jobs assigned to Node 0.
+
+    'sample' points to the queues of one sample, 'labels' to its 'length' node indices.
+*/
+int wasteForSample(const uint8_t* sample, const uint8_t* labels, int length, int dimension) {
+    int waste = 0;
+    // tasks
+    for (int i = 0; i < length; ++i) {
+        // assigned to Node 0
+        if (labels[i] == 0) {
+            for (int d = 0; d < dimension; ++d) {
+                waste += sample[length * dimension + i * dimension + d];
+            }
+        }
+    }
+    return waste;
+}
+
+/**
+    Copies the node resources of the sample into 'resources'.
+*/
+void extractResources(const uint8_t* sample, std::vector<int>& resources, int length, int dimension) {
+    resources.assign(sample, sample + length * dimension);
+}
+
+/**
+    Copies the prediction into 'checked', unassigning the jobs which don't fit on their node.
+
+    Prediction files only have labels. The networks can place such jobs on their next best
+    node instead, see decodeFeasibleLabels() and --repair.
+*/
+void checkPrediction(const uint8_t* sample,
+                     const uint8_t* prediction,
+                     uint8_t* checked,
+                     std::vector<int>& resources,
+                     int length,
+                     int dimension) {
+    extractResources(sample, resources, length, dimension);
+    // tasks
+    for (int i = 0; i < length; ++i) {
+        int assignment = prediction[i];
+        if (assignment != 0) {
+            bool valid = true;
+            for (int d = 0; d < dimension; ++d) {
+                resources[(assignment - 1) * dimension + d] -= sample[length * dimension + i * dimension + d];
+                if (resources[(assignment - 1) * dimension + d] < 0) {
+                    valid = false;
+                }
+            }
+            if (!valid) {
                 for (int d = 0; d < dimension; ++d) {
-                    waste += queues[sampleMarginInQueue * k + length * dimension + i * dimension + d];
+                    resources[(assignment - 1) * dimension + d] += sample[length * dimension + i * dimension + d];
                 }
+                checked[i] = 0;
+                continue;
             }
         }
-        ret.push_back(waste);
+        checked[i] = assignment;
     }
-    return ret;
 }
 
-std::vector<int> extractResources(const std::vector<int>& queues, int sample, int length, int dimension) {
-    std::vector<int> ret;
-    ret.reserve(length * dimension);
-    int sampleMargin = 2 * length * dimension + length * (length + 1);
-    for (int i = 0; i < length; ++i) {
-        for (int d = 0; d < dimension; ++d) {
-            ret.push_back(queues[sample * sampleMargin + i * dimension + d]);
+/**
+    Running mean and sum of squared differences (Welford).
+*/
+struct Stats {
+    double mean = 0;
+    double variance = 0;
+    long count = 0;
+
+    void add(double item) {
+        double prevMean = mean;
+        ++count;
+        mean = prevMean + (item - prevMean) / count;
+        variance = variance + (item - prevMean) * (item - mean);
+    }
+
+    /**
+        Combines the statistics of two disjoint sets of samples (Chan et al.).
+    */
+    void merge(const Stats& other) {
+        if (other.count == 0) {
+            return;
+        }
+        if (count == 0) {
+            *this = other;
+            return;
         }
+        long total = count + other.count;
+        double delta = other.mean - mean;
+        mean = mean + delta * other.count / total;
+        variance = variance + other.variance + delta * delta * count * other.count / total;
+        count = total;
     }
-    return ret;
+};
+
+/**
+    Normalizes the waste, so that the optimum is 0 and the worst solution is 1.
+*/
+double normalizedWaste(int waste, int wasteOpt, int wasteWorst) {
+    double divider = wasteWorst - wasteOpt;
+    divider = std::max(1., divider);
+    double shift = wasteOpt;
+    return (waste - shift) / divider;
 }
 
-struct SortableTask {
-    int originalIndex = 0;
-    int assignment = 0;
+struct Evaluation {
+    // one per prediction file, then the networks
+    std::vector<Stats> predictions;
+    Stats firstFit;
+    // in the order of allHeuristics()
+    std::vector<Stats> heuristics;
+    // jobs placed on the same node by the float and the int8 network
+    long agreeingJobs = 0;
+    long comparedJobs = 0;
+
+    void merge(const Evaluation& other) {
+        agreeingJobs += other.agreeingJobs;
+        comparedJobs += other.comparedJobs;
+        predictions.resize(std::max(predictions.size(), other.predictions.size()));
+        for (size_t p = 0; p < other.predictions.size(); ++p) {
+            predictions[p].merge(other.predictions[p]);
+        }
+        firstFit.merge(other.firstFit);
+        heuristics.resize(std::max(heuristics.size(), other.heuristics.size()));
+        for (size_t h = 0; h < other.heuristics.size(); ++h) {
+            heuristics[h].merge(other.heuristics[h]);
+        }
+    }
+};
+
+/**
+    Per sample buffers of evaluateSample(), reused from sample to sample.
+*/
+struct EvaluationScratch {
     std::vector<int> resources;
+    std::vector<uint8_t> checked;
+    std::vector<uint8_t> placement;
+    HeuristicScratch heuristic;
 };
 
-double harmonicMean(const std::vector<int>& nums) {
-    if (nums[0] == 0) {
-        return 0;
+/**
+    Computes the baseline record of one sample (see BaselineField): the optimal, worst case,
+    First Fit and heuristic wastes.
+
+    The First Fit placement comes from batchFirstFit(), run on the whole chunk beforehand.
+*/
+void computeBaselines(const uint8_t* sample,
+                      const uint8_t* optimum,
+                      const uint8_t* firstFit,
+                      int length,
+                      int dimension,
+                      const std::vector<Heuristic>& heuristics,
+                      EvaluationScratch& scratch,
+                      int32_t* record) {
+    record[OptimumWaste] = wasteForSample(sample, optimum, length, dimension);
+    // every job on Node 0
+    int wasteWorst = 0;
+    for (int i = 0; i < length * dimension; ++i) {
+        wasteWorst += sample[length * dimension + i];
     }
-    double sum = 0;
-    for (auto& item : nums) {
-        sum += 1. / (double)item;
+    record[WorstWaste] = wasteWorst;
+    record[FirstFitWaste] = wasteForSample(sample, firstFit, length, dimension);
+
+    scratch.placement.resize(length);
+    for (size_t h = 0; h < heuristics.size(); ++h) {
+        heuristics[h].place(sample, length, dimension, scratch.placement.data(), scratch.heuristic);
+        record[HeuristicWaste + h] = wasteForSample(sample, scratch.placement.data(), length, dimension);
     }
-    return nums.size() / sum;
 }
 
-std::vector<SortableTask> sortedTasks(const std::vector<int>& queues, int sample, int length, int dimension) {
-    std::vector<SortableTask> ret;
-    ret.reserve(length);
-    int sampleMargin = 2 * length * dimension + length * (length + 1);
-    for (int i = 0; i < length; ++i) {
-        SortableTask task;
-        task.originalIndex = i;
-        for (int d = 0; d < dimension; ++d) {
-            task.resources.push_back(queues[sample * sampleMargin + length * dimension + i * dimension + d]);
-        }
-        ret.push_back(task);
+/**
+    Evaluates one sample against its baseline record: validates every prediction
+    ('predictions[p]' points to the labels of prediction file 'p') and accumulates the normalized wastes.
+*/
+void evaluateSample(const uint8_t* sample,
+                    const int32_t* record,
+                    const std::vector<const uint8_t*>& predictions,
+                    int length,
+                    int dimension,
+                    int heuristicCount,
+                    EvaluationScratch& scratch,
+                    Evaluation& evaluation) {
+    int wasteOpt = record[OptimumWaste];
+    int wasteWorst = record[WorstWaste];
+    evaluation.firstFit.add(normalizedWaste(record[FirstFitWaste], wasteOpt, wasteWorst));
+
+    scratch.checked.resize(length);
+    evaluation.predictions.resize(predictions.size());
+    for (size_t p = 0; p < predictions.size(); ++p) {
+        checkPrediction(sample, predictions[p], scratch.checked.data(), scratch.resources, length, dimension);
+        int wastePred = wasteForSample(sample, scratch.checked.data(), length, dimension);
+        evaluation.predictions[p].add(normalizedWaste(wastePred, wasteOpt, wasteWorst));
+    }
+
+    evaluation.heuristics.resize(heuristicCount);
+    for (int h = 0; h < heuristicCount; ++h) {
+        evaluation.heuristics[h].add(normalizedWaste(record[HeuristicWaste + h], wasteOpt, wasteWorst));
     }
-    std::sort(ret.begin(), ret.end(), [] (const SortableTask& left, const SortableTask& right) -> bool {
-        return harmonicMean(left.resources) > harmonicMean(right.resources);
-    });
-    
-    return ret;
 }
 
-std::vector<int> checkPrediction(const std::vector<int>& queues,
-                                 const std::vector<int>& prediction,
-                                 int length,
-                                 int dimension) {
-    std::vector<int> ret;
-    ret.reserve(prediction.size());
-    int sampleMarginInQueue = 2 * length * dimension + length * (length + 1);
-    int sampleMargin = length * (length + 1);
-    int sampleSize = prediction.size() / sampleMargin;
-
-    // samples
-    for (int k = 0; k < sampleSize; ++ k) {
-        auto resources = extractResources(queues, k, length, dimension);
-        // tasks
-        for (int i = 0; i < length; ++i) {
-            int assignment = 0;
-            // assignment
-            for (int j = 0; j < (length + 1); ++j) {
-                if (prediction[sampleMargin * k + i * (length + 1) + j] == 1) {
-                    assignment = j;
-                    break;
+/**
+    The networks evaluated next to the prediction files, both optional.
+*/
+struct Networks {
+    const Network* network = nullptr;
+    const QuantizedNetwork* quantized = nullptr;
+    // index of each network's results in Evaluation::predictions (and its name), -1 without the network
+    int networkIndex = -1;
+    int quantizedIndex = -1;
+    // decodes the labels with decodeFeasibleLabels()
+    bool repair = false;
+
+    int count() const {return (network != nullptr) + (quantized != nullptr);}
+};
+
+// Samples are evaluated in chunks of this size, independently of the number of threads.
+const long EvaluationChunkSize = 4096;
+
+/**
+    Evaluates the samples against every prediction file on 'threads' threads.
+
+    The predictions of the networks are computed chunk by chunk and evaluated after the files.
+    If both the float and the int8 network are given, their placements are compared job by job.
+    The baselines of a sample are computed once and shared by all the predictions. They are taken from
+    'cached' (baseline records of the samples) if it isn't null, otherwise they are computed into 'computed'.
+    Every chunk of samples gets its own partial statistics, accumulated by its worker and stored once the
+    chunk is done. They are merged into 'evaluation' in chunk order, so the result is bit-for-bit the same for any number of threads.
+*/
+void evaluate(const Samples& training, const std::vector<Samples>& predictions, const Networks& networks,
+              int length, int dimension, int threads, const int32_t* cached, std::vector<int32_t>& computed,
+              Evaluation& evaluation) {
+    long chunks = (training.size + EvaluationChunkSize - 1) / EvaluationChunkSize;
+    std::vector<Evaluation> partials(chunks);
+    std::atomic<long> nextChunk(0);
+    int queueSize = 2 * length * dimension;
+    auto heuristics = allHeuristics();
+    int stride = baselineStride(heuristics.size());
+    if (!cached) {
+        computed.resize((size_t)training.size * stride);
+    }
+    const int32_t* records = cached ? cached : computed.data();
+
+    auto worker = [&] () {
+        EvaluationScratch scratch;
+        BatchScratch batchScratch;
+        std::vector<uint8_t> firstFit(EvaluationChunkSize * length);
+        NetworkScratch networkScratch;
+        QuantizedScratch quantizedScratch;
+        std::vector<uint8_t> networkLabels(networks.network ? EvaluationChunkSize * length : 0);
+        std::vector<uint8_t> quantizedLabels(networks.quantized ? EvaluationChunkSize * length : 0);
+        std::vector<const uint8_t*> labels(predictions.size() + networks.count());
+        for (long c = nextChunk++; c < chunks; c = nextChunk++) {
+            long begin = c * EvaluationChunkSize;
+            long end = std::min((long)training.size, begin + EvaluationChunkSize);
+            // accumulated locally, the partials of neighbouring chunks share cache lines
+            Evaluation partial;
+            if (!cached) {
+                batchFirstFit(training.queues.data() + begin * queueSize, end - begin, length, dimension,
+                              firstFit.data(), batchScratch);
+                for (long k = begin; k < end; ++k) {
+                    computeBaselines(training.queues.data() + k * queueSize,
+                                     training.labels.data() + k * length,
+                                     firstFit.data() + (k - begin) * length,
+                                     length, dimension, heuristics, scratch, computed.data() + k * stride);
                 }
             }
-            if (assignment != 0) {
-                bool valid = true;
-                for (int d = 0; d < dimension; ++d) {
-                    resources[(assignment - 1) * dimension + d] 
-                        -= queues[sampleMarginInQueue * k + length * dimension + i * dimension + d];
-                    if (resources[(assignment - 1) * dimension + d] < 0) {
-                        valid = false;
-                    }
-                }
-                if (!valid) {
-                    for (int d = 0; d < dimension; ++d) {
-                        resources[i * dimension + d] 
-                            += queues[sampleMarginInQueue * k + length * dimension + i * dimension + d];
-                    }
-                    ret.push_back(1);
-                    for (int m = 0; m < length; ++m) {
-                        ret.push_back(0);
-                    }
-                    continue;
+            if (networks.network) {
+                networks.network->predict(training.queues.data() + begin * queueSize, end - begin,
+                                          networkLabels.data(), networkScratch, networks.repair);
+            }
+            if (networks.quantized) {
+                networks.quantized->predict(training.queues.data() + begin * queueSize, end - begin,
+                                            quantizedLabels.data(), quantizedScratch, networks.repair);
+            }
+            if (networks.network && networks.quantized) {
+                long jobs = (end - begin) * length;
+                for (long i = 0; i < jobs; ++i) {
+                    partial.agreeingJobs += networkLabels[i] == quantizedLabels[i];
                 }
+                partial.comparedJobs += jobs;
             }
-            for (int m = 0; m < (length + 1); ++m) {
-                ret.push_back(prediction[sampleMargin * k + i * (length + 1) + m]);
+            for (long k = begin; k < end; ++k) {
+                for (size_t p = 0; p < predictions.size(); ++p) {
+                    labels[p] = predictions[p].labels.data() + k * length;
+                }
+                if (networks.network) {
+                    labels[networks.networkIndex] = networkLabels.data() + (k - begin) * length;
+                }
+                if (networks.quantized) {
+                    labels[networks.quantizedIndex] = quantizedLabels.data() + (k - begin) * length;
+                }
+                evaluateSample(training.queues.data() + k * queueSize, records + k * stride, labels,
+                               length, dimension, heuristics.size(), scratch, partial);
             }
+            partials[c] = std::move(partial);
         }
+    };
+    std::vector<std::thread> workers;
+    for (int t = 1; t < std::min((long)threads, chunks); ++t) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : workers) {
+        t.join();
     }
-    return ret;
-}
-
-std::vector<int> worstPrediction(int sampleSize, int length) {
-    std::vector<int> ret;
-    ret.reserve(sampleSize * length * (length + 1));
 
-    for (int k = 0; k < sampleSize; ++k) {
-        for (int i = 0; i < length; ++i) {
-            ret.push_back(1);
-            for (int j = 0; j < length; ++j) {
-                ret.push_back(0);
-            }
-        }
+    for (const auto& partial : partials) {
+        evaluation.merge(partial);
     }
+}
 
-    return ret;
+/**
+    Key of the baseline sidecar of the training set of 'opts'.
+*/
+BaselineKey baselineKey(const Options& opts) {
+    MappedFile file(opts.getPathTr());
+    if (!file.isOpen()) {
+        throw EvaluateException("Can't open " + opts.getPathTr() + ".");
+    }
+    BaselineKey key;
+    key.hash = contentHash(file.data(), file.size());
+    key.size = file.size();
+    key.length = opts.getLength();
+    key.dimension = opts.getDimension();
+    auto heuristics = allHeuristics();
+    key.heuristics = heuristics.size();
+    std::vector<std::string> names;
+    for (const auto& heuristic : heuristics) {
+        names.push_back(heuristic.name());
+    }
+    key.heuristicsHash = namesHash(names);
+    return key;
 }
 
-bool tryAssignTaskToNode(std::vector<int>& workQueue, const SortableTask& task, int nodeId) {
-    bool valid = true;
-    int dimension = task.resources.size();
-    for (int d = 0; d < dimension; ++d) {
-        workQueue[nodeId * dimension + d] -= task.resources[d];
-        if (workQueue[nodeId * dimension + d] < 0) {
-            valid = false;
+/**
+    Evaluates the training set and all prediction files in lockstep, a block of chunks at a time,
+    with constant memory use.
+
+    Blocks are whole chunks, so the result matches the in-memory evaluation.
+    Returns true if the baselines came from the sidecar.
+*/
+bool evaluateStream(const Options& opts, const Networks& networks, Evaluation& evaluation) {
+    int length = opts.getLength();
+    int dim = opts.getDimension();
+    const auto& paths = opts.getPathsPr();
+    SampleStream trainingStream(opts.getPathTr(), 2 * length * dim, length);
+    std::vector<std::unique_ptr<SampleStream>> predictionStreams;
+    for (const auto& path : paths) {
+        predictionStreams.emplace_back(new SampleStream(path, 0, length));
+    }
+    long blockSize = EvaluationChunkSize * opts.getThreads();
+
+    std::unique_ptr<BaselineFile> baseline;
+    std::unique_ptr<BaselineWriter> baselineWriter;
+    if (opts.useBaseline()) {
+        auto key = baselineKey(opts);
+        baseline.reset(new BaselineFile(opts.getBaselinePath(), key));
+        if (!baseline->isValid()) {
+            baseline.reset();
+            baselineWriter.reset(new BaselineWriter(opts.getBaselinePath(), key));
         }
     }
-    if (!valid) {
-        for (int d = 0; d < dimension; ++d) {
-            workQueue[nodeId * dimension + d] += task.resources[d];
+    int stride = baselineStride(allHeuristics().size());
+    std::vector<int32_t> computed;
+    long done = 0;
+
+    Samples training;
+    std::vector<Samples> predictions(paths.size());
+    bool left = true;
+    bool mismatch = false;
+    while (left) {
+        training.clear();
+        for (auto& prediction : predictions) {
+            prediction.clear();
         }
+        while (left && training.size < blockSize) {
+            bool trainingLeft = trainingStream.next(training);
+            for (size_t p = 0; p < paths.size(); ++p) {
+                bool predictionLeft = predictionStreams[p]->next(predictions[p]);
+                mismatch = mismatch || predictionLeft != trainingLeft;
+                left = left && predictionLeft;
+            }
+            left = left && trainingLeft;
+        }
+        int size = training.size;
+        for (const auto& prediction : predictions) {
+            size = std::min(size, prediction.size);
+        }
+        truncate(training, size, 2 * length * dim, length);
+        for (auto& prediction : predictions) {
+            truncate(prediction, size, 0, length);
+        }
+        const int32_t* cached = nullptr;
+        if (baseline && done + size <= baseline->samples()) {
+            cached = baseline->records() + done * stride;
+        }
+        evaluate(training, predictions, networks, length, dim, opts.getThreads(), cached, computed, evaluation);
+        if (baselineWriter) {
+            baselineWriter->append(computed.data(), size);
+        }
+        done += size;
+    }
+    if (mismatch) {
+        std::cerr << "Warning: the training set and the predictions have a different number of samples, "
+                  << "evaluated the first " << evaluation.firstFit.count << "." << std::endl;
+    } else if (baselineWriter && !baselineWriter->commit()) {
+        std::cerr << "Warning: can't write " << opts.getBaselinePath() << "." << std::endl;
     }
-    return valid;
+    return baseline != nullptr;
 }
 
-std::vector<int> calculateFirstFit(const std::vector<int>& queues, int length, int dimension) {
-    std::vector<int> ret;
-    int sampleSize = queues.size() / (2 * length * dimension + length * (length + 1));
-    ret.reserve(sampleSize * length * (length + 1));
+// Share of the jobs the session may place differently, near ties are decided by float rounding.
+const double SessionTolerance = 1e-4;
+// samples between two checks for a new version of the network file
+const long SessionRefreshInterval = 4096;
 
-    for (int k = 0; k < sampleSize; ++k) {
-        auto resources = extractResources(queues, k, length, dimension);
-        auto tasks = sortedTasks(queues, k, length, dimension);
-        for (int i = 0; i < length; ++i) {
-            for (int j = 0; j < length; ++j) {
-                if (tryAssignTaskToNode(resources, tasks[i], j)) {
-                    tasks[i].assignment = j + 1;
-                    break;
-                }
+/**
+    Placements of an InferenceSession compared with Network::predict(), see checkSession().
+*/
+struct SessionCheck {
+    long agreeingJobs = 0;
+    long comparedJobs = 0;
+    long updates = 0;
+    // new versions of the network file swapped in during the replay
+    int swaps = 0;
+    double seconds = 0;
+};
+
+/**
+    Replays the samples through one InferenceSession like an online placer would: the nodes and
+    jobs of every sample are set as changes of the previous sample (rank-k updates, no full pass
+    after the first sample), then every job is placed. The placements are compared job by job
+    with Network::predict() on the same samples.
+
+    Like a long running placer, the session checks the network file for a new version every
+    SessionRefreshInterval samples. A swapped in network gets a new session and the rest of the
+    samples are compared with its predictions.
+*/
+SessionCheck checkSession(const Samples& training, NetworkWatcher& watcher) {
+    auto network = watcher.get();
+    int length = network->length();
+    int dimension = network->dimension();
+    int queueSize = 2 * length * dimension;
+    SessionCheck ret;
+    if (training.size == 0) {
+        return ret;
+    }
+    std::vector<uint8_t> expected((size_t)training.size * length);
+    NetworkScratch scratch;
+    network->predict(training.queues.data(), training.size, expected.data(), scratch);
+
+    std::unique_ptr<InferenceSession> session(new InferenceSession(network));
+    auto start = std::chrono::steady_clock::now();
+    session->reset(training.queues.data());
+    for (long k = 0; k < training.size; ++k) {
+        const uint8_t* sample = training.queues.data() + k * queueSize;
+        bool swapped = false;
+        if (k > 0 && k % SessionRefreshInterval == 0) {
+            try {
+                swapped = watcher.refresh();
+            } catch(const NetworkException& e) {
+                std::cerr << "Warning: " << e.what() << " Keeping the current network." << std::endl;
             }
         }
-        for (int i = 0; i < length; ++i) {
-            // linear search, could do better
-            for (auto& task : tasks) {
-                if (task.originalIndex == i) {
-                    for (int d = 0; d < (length + 1); ++d) {
-                        if (task.assignment == d) {
-                            ret.push_back(1);
-                        } else {
-                            ret.push_back(0);
-                        }
-                    }
-                    break;
+        if (swapped) {
+            // the reference placements aren't part of the decision time
+            auto swapStart = std::chrono::steady_clock::now();
+            network = watcher.get();
+            network->predict(sample, training.size - k, expected.data() + k * length, scratch);
+            start += std::chrono::steady_clock::now() - swapStart;
+            session.reset(new InferenceSession(network));
+            session->reset(sample);
+            ++ret.swaps;
+        } else if (k > 0) {
+            const uint8_t* previous = sample - queueSize;
+            for (int i = 0; i < 2 * length; ++i) {
+                if (std::equal(sample + i * dimension, sample + (i + 1) * dimension, previous + i * dimension)) {
+                    continue;
+                }
+                if (i < length) {
+                    session->setNode(i, sample + i * dimension);
+                } else {
+                    session->setJob(i - length, sample + i * dimension);
                 }
+                ++ret.updates;
             }
         }
+        for (int i = 0; i < length; ++i) {
+            ret.agreeingJobs += session->place(i) == expected[k * length + i];
+        }
     }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    ret.seconds = elapsed.count();
+    ret.comparedJobs = (long)training.size * length;
     return ret;
 }
 
-struct Stats {
-    double mean = 0;
-    double variance = 0;
-};
-
-Stats calculateStatistics(const std::vector<int>& wasteWorstPred,
-                          const std::vector<int>& wasteOpt,
-                          const std::vector<int>& wastePred) {
-    int sampleSize = wasteOpt.size();
-    Stats stats;
-    double prevMean = 0;
-    double mean = 0;
-    double variance = 0;
-    for (int i = 0; i < sampleSize; ++i) {
-        prevMean = mean;
-        // normalize
-        double divider = wasteWorstPred[i] - wasteOpt[i];
-        divider = std::max(1., divider);
-        double shift = wasteOpt[i];
-        double item = (wastePred[i] - shift) / divider;
-        mean = prevMean + (item - prevMean) / (i + 1);
-        variance = variance + (item - prevMean) * (item - mean);
-    }    
-    stats.mean = mean;
-    stats.variance = variance;
-    return stats;
+void printSessionCheck(const SessionCheck& check) {
+    std::cout << "Inference session\n\nSame node as the network: "
+              << 100. * check.agreeingJobs / std::max(1L, check.comparedJobs) << "% of the jobs ("
+              << check.comparedJobs - check.agreeingJobs << " differ)"
+              << "\nTime per decision: " << 1e6 * check.seconds / std::max(1L, check.comparedJobs)
+              << " us, with " << (double)check.updates / std::max(1L, check.comparedJobs) << " item updates per decision"
+              << "\nNetwork swaps: " << check.swaps << "\n" << std::endl;
 }
 
-void printStatistics(const std::vector<int>& wasteWorstPred,
-                     const std::vector<int>& wasteOpt,
-                     const std::vector<int>& wastePred,
-                     const std::vector<int>& wasteFF) {
-    
-    int sampleSize = wasteOpt.size();
-    auto predStats = calculateStatistics(wasteWorstPred, wasteOpt, wastePred);
-    auto ffStats = calculateStatistics(wasteWorstPred, wasteOpt, wasteFF);
+void printStatistics(const Evaluation& evaluation, const Networks& networks, const std::vector<std::string>& names) {
+    const auto& ffStats = evaluation.firstFit;
+    long sampleSize = ffStats.count;
 
-    std::cout << "\nComparison of wasted resources for First Fit (FF) and provided prediction.\n";
+    std::cout << "\nComparison of wasted resources for First Fit Decreasing (harmonic) and provided prediction.\n";
     std::cout << "\nThe waste is normalized. Optimal solution has mean 0 and the worst solution has mean 1.\n\n";
-    std::cout << "First Fit\n\nMean: " << ffStats.mean << "\nStandard deviation: " << std::sqrt(ffStats.variance / sampleSize);
-    std::cout << "\n\nCustom Algorithm\n\nMean: " << predStats.mean
-     << "\nStandard deviation: " << std::sqrt(predStats.variance / sampleSize) << std::endl;
+    std::cout << "First Fit Decreasing (harmonic)\n\nMean: " << ffStats.mean << "\nStandard deviation: " << std::sqrt(ffStats.variance / sampleSize);
+    if (evaluation.predictions.size() == 1) {
+        const auto& predStats = evaluation.predictions.front();
+        std::cout << "\n\nCustom Algorithm\n\nMean: " << predStats.mean
+         << "\nStandard deviation: " << std::sqrt(predStats.variance / sampleSize) << std::endl;
+    } else {
+        std::cout << "\n\nPredictions\n\n";
+        std::cout << std::left << std::setw(12) << "Mean" << std::setw(20) << "Standard deviation" << "File\n";
+        for (size_t p = 0; p < evaluation.predictions.size(); ++p) {
+            const auto& stats = evaluation.predictions[p];
+            std::cout << std::left << std::setw(12) << stats.mean << std::setw(20)
+                      << std::sqrt(stats.variance / sampleSize) << names[p] << "\n";
+        }
+    }
+    if (evaluation.comparedJobs > 0) {
+        const auto& floatStats = evaluation.predictions[networks.networkIndex];
+        const auto& int8Stats = evaluation.predictions[networks.quantizedIndex];
+        std::cout << "\nInt8 network\n\nSame node as the float network: "
+                  << 100. * evaluation.agreeingJobs / evaluation.comparedJobs << "% of the jobs"
+                  << "\nWaste delta (int8 - float): " << int8Stats.mean - floatStats.mean << "\n";
+    }
+
+    auto heuristics = allHeuristics();
+    std::cout << "\nHeuristic baselines\n\n";
+    std::cout << std::left << std::setw(22) << "Name" << std::setw(12) << "Mean" << "Standard deviation\n";
+    for (size_t h = 0; h < evaluation.heuristics.size(); ++h) {
+        const auto& stats = evaluation.heuristics[h];
+        std::cout << std::left << std::setw(22) << heuristics[h].name() << std::setw(12) << stats.mean
+                  << std::sqrt(stats.variance / sampleSize) << "\n";
+    }
     std::cout << std::endl;
 }
 
@@ -372,28 +906,124 @@ int main(int argc, char* argv[]) {
     // opts.print();
     int length = opts.getLength();
     int dim = opts.getDimension();
+    const auto& paths = opts.getPathsPr();
+    auto names = paths;
 
-    auto queues = readInput(opts.getPathTr(), 2 * length * dim + length * (length + 1));
-    
-    auto prediction = readInput(opts.getPathPr(), length * (length + 1));
-    prediction = checkPrediction(queues, prediction, length, dim);
-    int sampleSize = prediction.size() / (length * (length + 1));
-    
-    auto firstFit = calculateFirstFit(queues, length, dim);
-    auto worstPred = worstPrediction(sampleSize, length);
-    
-    auto wasteOpt = wasteForOptimum(queues, length, dim);
-    auto wastePred = wasteForSet(queues, prediction, length, dim);
-    auto wasteWorstPred = wasteForSet(queues, worstPred, length, dim);
-    auto wasteFF = wasteForSet(queues, firstFit, length, dim);
-
-    printStatistics(wasteWorstPred, wasteOpt, wastePred, wasteFF);
-    return 0;
-}
-
-
-
+    // -w is loaded through a watcher, so --session picks up a replaced network file
+    std::unique_ptr<NetworkWatcher> watcher;
+    std::shared_ptr<const Network> network;
+    std::unique_ptr<QuantizedNetwork> quantized;
+    Networks networks;
+    if (opts.getWeightsPath().length() > 0) {
+        try {
+            watcher.reset(new NetworkWatcher(opts.getWeightsPath(), length, dim));
+            network = watcher->get();
+            if (opts.getModelPath().length() > 0) {
+                network->save(opts.getModelPath(), true);
+            }
+            if (opts.isInt8()) {
+                // a model file has the int8 weights already
+                const auto& model = network->model();
+                if (model && model->has(ModelSection::QuantizedWeights1)) {
+                    quantized.reset(new QuantizedNetwork(*model));
+                } else {
+                    quantized.reset(new QuantizedNetwork(*network));
+                }
+            }
+        } catch(const NetworkException& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        networks.network = network.get();
+        networks.networkIndex = names.size();
+        networks.repair = opts.isRepair();
+        std::string suffix = opts.isRepair() ? " (repaired)" : "";
+        names.push_back("network " + opts.getWeightsPath() + suffix);
+        if (quantized) {
+            networks.quantized = quantized.get();
+            networks.quantizedIndex = names.size();
+            names.push_back("int8 network " + opts.getWeightsPath() + suffix);
+        }
+    }
 
+    Evaluation evaluation;
+    auto start = std::chrono::steady_clock::now();
+    if (opts.isStream()) {
+        bool cached = false;
+        try {
+            cached = evaluateStream(opts, networks, evaluation);
+        } catch(const EvaluateException& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        printStatistics(evaluation, networks, names);
+        std::cout << "Evaluated " << evaluation.firstFit.count << " samples in " << elapsed.count()
+                  << " s using " << opts.getThreads() << " threads" << (cached ? ", baselines from the sidecar." : ".")
+                  << std::endl;
+        return 0;
+    }
 
+    Samples training;
+    std::vector<Samples> predictions;
+    std::unique_ptr<BaselineFile> baseline;
+    BaselineKey key;
+    try {
+        int threads = opts.getThreads();
+        training = readInput(opts.getPathTr(), 2 * length * dim, length, threads);
+        for (const auto& path : paths) {
+            predictions.push_back(readInput(path, 0, length, threads));
+        }
+        if (opts.useBaseline()) {
+            key = baselineKey(opts);
+            baseline.reset(new BaselineFile(opts.getBaselinePath(), key));
+            if (!baseline->isValid() || baseline->samples() != training.size) {
+                baseline.reset();
+            }
+        }
+    } catch(const EvaluateException& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    int trainingSize = training.size;
+    int sampleSize = training.size;
+    for (const auto& prediction : predictions) {
+        sampleSize = std::min(sampleSize, prediction.size);
+    }
+    for (size_t p = 0; p < paths.size(); ++p) {
+        if (training.size != predictions[p].size) {
+            std::cerr << "Warning: " << training.size << " training samples and " << predictions[p].size
+                      << " predictions in " << paths[p] << ", evaluating the first " << sampleSize << "." << std::endl;
+        }
+        truncate(predictions[p], sampleSize, 0, length);
+    }
+    truncate(training, sampleSize, 2 * length * dim, length);
 
+    std::vector<int32_t> computed;
+    const int32_t* cached = baseline ? baseline->records() : nullptr;
+    evaluate(training, predictions, networks, length, dim, opts.getThreads(), cached, computed, evaluation);
+    // only baselines of the whole training set are worth keeping
+    if (opts.useBaseline() && !cached && sampleSize == trainingSize) {
+        BaselineWriter baselineWriter(opts.getBaselinePath(), key);
+        baselineWriter.append(computed.data(), sampleSize);
+        if (!baselineWriter.commit()) {
+            std::cerr << "Warning: can't write " << opts.getBaselinePath() << "." << std::endl;
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
 
+    printStatistics(evaluation, networks, names);
+    std::cout << "Evaluated " << sampleSize << " samples against " << names.size() << " prediction(s) in "
+              << elapsed.count() << " s using " << opts.getThreads() << " threads"
+              << (cached ? ", baselines from the sidecar." : ".") << std::endl;
+    if (opts.isSession()) {
+        auto check = checkSession(training, *watcher);
+        std::cout << std::endl;
+        printSessionCheck(check);
+        if (check.comparedJobs - check.agreeingJobs > SessionTolerance * check.comparedJobs) {
+            std::cerr << "The inference session drifted away from the network." << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,125 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <vector>
+#include <chrono>
+
+#include "cxxopts.hpp"
+
+#include "Features.h"
+#include "IntParser.h"
+#include "OctaveBinary.h"
+
+/**
+    Handles command line options.
+*/
+class Options {
+private:
+    std::string mPath;
+    std::string mOutputPath;
+    int mLength = 12;
+    int mDimension = 2;
+    bool mHelp = false;
+    cxxopts::Options options;
+    void ensureConsistency() {
+        mLength = std::max(1, mLength);
+        mDimension = std::max(1, mDimension);
+        if (mPath.length() == 0) {
+            throw cxxopts::OptionException("Path to training set can't be empty.");
+        }
+        if (mOutputPath.length() == 0) {
+            throw cxxopts::OptionException("Output path can't be empty.");
+        }
+    }
+public:
+    Options() : options("expand", "Expands a training set like octave/expand.m into a binary Octave matrix") {
+        options.add_options()
+          ("f,file", "Training set, one-hot or compact labels, - reads the standard input", cxxopts::value<std::string>(mPath)
+                ->default_value("train.txt"))
+          ("o,output", "The transposed XY_exp is saved here as XY_exp_t", cxxopts::value<std::string>(mOutputPath)
+                ->default_value("train_exp.bin"))
+          ("l,length", "Length of the queues (default: 12)", cxxopts::value<int>(mLength))
+          ("d,dim", "Dimension of the items (default: 2)", cxxopts::value<int>(mDimension))
+          ("h,help", "Prints help", cxxopts::value<bool>(mHelp))
+        ;
+    }
+    bool parseCMDLine(int argc, char* argv[]) {
+        try {
+            options.parse(argc, argv);
+            ensureConsistency();
+        } catch(const cxxopts::OptionException& e) {
+            std::cerr << "error parsing options: " << e.what() << std::endl;
+            return false;
+        }
+        return true;
+    }
+    std::string getPath() const {return mPath;}
+    std::string getOutputPath() const {return mOutputPath;}
+    int getLength() const {return mLength;}
+    int getDimension() const {return mDimension;}
+    bool isHelp() const {return mHelp;}
+    std::string helpMessage() const {return options.help({""});}
+    void print() const {
+        std::cout << "options = {"
+                  << "\n  file: " << mPath
+                  << ",\n  output: " << mOutputPath
+                  << ",\n  length: " << mLength
+                  << ",\n  dimension: " << mDimension
+                  << ",\n  help: " << mHelp
+                  << "\n}" << std::endl;
+    }
+};
+
+int main(int argc, char* argv[]) {
+    Options opts;
+    if (!opts.parseCMDLine(argc, argv)) {
+        return 1;
+    }
+    if (opts.isHelp())
+    {
+        std::cout << opts.helpMessage() << std::endl;
+        return 0;
+    }
+    // opts.print();
+    std::ifstream file;
+    if (opts.getPath() != "-") {
+        file.open(opts.getPath());
+        if (!file) {
+            std::cerr << "Can't open " << opts.getPath() << "." << std::endl;
+            return 1;
+        }
+    }
+    std::istream& input = (opts.getPath() == "-") ? std::cin : file;
+
+    auto start = std::chrono::steady_clock::now();
+    FeatureExpander expander(opts.getLength(), opts.getDimension());
+    OctaveMatrixWriter writer(opts.getOutputPath(), "XY_exp_t", expander.columns(), OctaveType::Double);
+    std::vector<int> items;
+    std::vector<double> row(expander.columns());
+    std::string line;
+    long lineNumber = 0;
+    // records are expanded as they are read
+    while (std::getline(input, line)) {
+        ++lineNumber;
+        auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+        if (!parseIntLine(line.data(), line.data() + line.size(), items)
+            || !expander.expand(items.data(), items.size(), row.data())) {
+            std::cerr << "Malformed record in line " << lineNumber << "." << std::endl;
+            return 1;
+        }
+        writer.append(row.data());
+    }
+    if (!writer.commit()) {
+        std::cerr << "Can't write " << opts.getOutputPath() << "." << std::endl;
+        return 1;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Expanded " << writer.columns() << " records into " << opts.getOutputPath() << " in "
+              << elapsed.count() << " s." << std::endl;
+    return 0;
+}
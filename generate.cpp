@@ -12,6 +12,8 @@
 
 #include "cxxopts.hpp"
 
+#include "Generator.h"
+
 /**
     Handles command line options.
 */
@@ -98,64 +100,6 @@ void print_naked(const Sequence& sequence) {
     std::cout << "\n";
 }
 
-/**
-    Returns a random distribution that marks the place of
-    empty and real elements.
-*/
-std::vector<bool> randomizedNullItems(int length, double ratio) {
-    std::vector<bool> items(2 * length);
-    int nullItems = ratio * 2 * length;
-    for (int i = 0; i < nullItems; ++i) {
-        items[i] = 1;
-    }
-    
-    // randomize the items
-    unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
-    std::mt19937 m(seed);
-    // TODO
-    // Does std::shuffle() work on vector<bool>?
-    std::shuffle(items.begin(), items.end(), m);
-
-    return items;
-}
-
-/**
-    Returns a random vector of integers whose elements are between 1 and 100.
-    
-    The hidden structure is the following:
-    - Two consecutive 'length' number of tuples of 'dimension' number of items.
-    - First tuple array represents the node resources.
-    - Second tupple array represents the job resources.
-*/
-std::vector<int> generate(const Options& opts) {
-    int length = opts.getLength();
-    int dim = opts.getDimension();
-    auto nullItemDistribution = randomizedNullItems(length, opts.getRatio());
-
-    unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
-    std::mt19937 m(seed);
-    
-    std::uniform_int_distribution<int> dist(1, 100);
-    auto dice = std::bind(dist, m);
-    
-    // assembling return vector
-    std::vector<int> ret;
-    ret.reserve(2 * length);
-    for (int i = 0; i < 2 * length; ++i) {
-        if (nullItemDistribution[i]) {
-            for (int d = 0; d < dim; ++d) {
-                ret.push_back(0);
-            }
-        } else {
-            for (int d = 0; d < dim; ++d) {
-                ret.push_back(dice());
-            }
-        }
-    }
-
-    return ret;
-}
-
 int main(int argc, char* argv[]) {
     Options opts;
     if (!opts.parseCMDLine(argc, argv)) {   
@@ -167,9 +111,11 @@ int main(int argc, char* argv[]) {
         return 0;
     }
     
+    unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+    auto generator = Generator(opts.getLength(), opts.getDimension(), seed);
     int size = opts.getSize();
     for (int i = 0; i < size; ++i) {
-        auto ret = generate(opts);
+        auto ret = generator.generate(opts.getRatio());
         if (opts.isNaked()) {
             print_naked(ret);
         } else {
@@ -0,0 +1,34 @@
+function checkCostFunction(lambda)
+%CHECKCOSTFUNCTION Compares nnCostFunctionFast with nnCostFunction.
+%   checkCostFunction(lambda) runs both on a small random network and prints
+%   the relative differences of their costs and gradients.
+
+if ~exist('lambda', 'var') || isempty(lambda)
+	lambda = 1;
+end
+
+number_of_nodes = 3;
+dimension = 2;
+input_layer_size = number_of_nodes * dimension * 2 + 2 * number_of_nodes;
+hidden_layer_size = 5;
+num_labels = number_of_nodes * (number_of_nodes + 1);
+m = 300;
+
+Theta1 = randInitializeWeights(input_layer_size, hidden_layer_size);
+Theta2 = randInitializeWeights(hidden_layer_size, num_labels);
+nn_params = [Theta1(:) ; Theta2(:)];
+
+XY = [randi([0 100], m, number_of_nodes * dimension * 2), ...
+      expandLabels(randi([0 number_of_nodes], m, number_of_nodes), number_of_nodes)];
+XY_exp = expand(XY, number_of_nodes, dimension);
+X = XY_exp(:, 1:input_layer_size);
+y = XY_exp(:, (input_layer_size + 1):end);
+
+[J grad] = nnCostFunction(nn_params, input_layer_size, hidden_layer_size, num_labels, X, y, lambda);
+[J_fast grad_fast] = nnCostFunctionFast(nn_params, input_layer_size, hidden_layer_size, num_labels, X, y, lambda);
+
+fprintf('Cost: %e, relative difference: %e\n', J, abs(J - J_fast) / abs(J));
+fprintf('Gradient relative difference: %e\n', norm(grad - grad_fast) / norm(grad));
+fprintf('Both should be below 1e-9.\n');
+
+end
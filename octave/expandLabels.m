@@ -0,0 +1,14 @@
+function Y = expandLabels(labels, number_of_nodes)
+%EXPANDLABELS Expands compact labels into one-hot blocks.
+%   Y = EXPANDLABELS(labels, number_of_nodes) turns each node index (0 means unassigned)
+%   into a block of (number_of_nodes + 1) columns with a single 1 in it.
+
+m = size(labels, 1);
+jobs = size(labels, 2);
+Y = zeros(m, jobs * (number_of_nodes + 1));
+
+for j = 1:jobs
+	Y(sub2ind(size(Y), (1:m)', labels(:, j) + 1 + (j - 1) * (number_of_nodes + 1))) = 1;
+end
+
+end
@@ -7,13 +7,38 @@ input_layer_size  = number_of_nodes * dimension * 2 + 2 * number_of_nodes; % Las
 hidden_layer_size = 440;
 num_labels = number_of_nodes * (number_of_nodes + 1);
 
-fprintf('Loading train.txt\n');
-fflush(stdout);
-load('train.txt');
-
-fprintf('Expanding training data.\n');
-fflush(stdout);
-XY_exp = expand(XY, number_of_nodes, dimension);
+% written by "expand -f train.txt -o train_exp.bin", already expanded
+if exist('train_exp.bin', 'file')
+	fprintf('Loading train_exp.bin\n');
+	fflush(stdout);
+	load('train_exp.bin');
+	XY_exp = XY_exp_t';
+	clear XY_exp_t;
+	XY = XY_exp(:, (2 * number_of_nodes + 1):end);
+elseif exist('train.bin', 'file')
+	% written by "build_dataset --binary" or "annotate --binary", one record per column
+	fprintf('Loading train.bin\n');
+	fflush(stdout);
+	load('train.bin');
+	XY = XY_t';
+	clear XY_t;
+else
+	fprintf('Loading train.txt\n');
+	fflush(stdout);
+	load('train.txt');
+end
+
+if !exist('XY_exp', 'var')
+	% annotate --compact stores one node index per job
+	if size(XY, 2) == number_of_nodes * dimension * 2 + number_of_nodes
+		XY = [XY(:, 1:(number_of_nodes * dimension * 2)), ...
+		      expandLabels(XY(:, (number_of_nodes * dimension * 2 + 1):end), number_of_nodes)];
+	end
+
+	fprintf('Expanding training data.\n');
+	fflush(stdout);
+	XY_exp = expand(XY, number_of_nodes, dimension);
+end
 
 tr_size = 10000;
 val_size = 500;
@@ -56,10 +81,18 @@ options = optimset('MaxIter', 500);
 lambda = 1;
 
 % Create "short hand" for the cost function to be minimized
-costFunction = @(p) nnCostFunction(p, ...
-                                   input_layer_size, ...
-                                   hidden_layer_size, ...
-                                   num_labels, X, y, lambda);
+% The compiled nnCostFunctionFast ("make octave/nnCostFunctionFast.oct") is used when it's built
+if exist('nnCostFunctionFast') == 3
+	costFunction = @(p) nnCostFunctionFast(p, ...
+	                                       input_layer_size, ...
+	                                       hidden_layer_size, ...
+	                                       num_labels, X, y, lambda);
+else
+	costFunction = @(p) nnCostFunction(p, ...
+	                                   input_layer_size, ...
+	                                   hidden_layer_size, ...
+	                                   num_labels, X, y, lambda);
+end
 
 % Now, costFunction is a function that takes in only one argument (the
 % neural network parameters)
@@ -85,6 +118,7 @@ fprintf('\nValidation Set Accuracy: %f\n', mean(double((sum(pred_val == y_val, 2
 X_opt = XY(sel_val,:);
 save X_opt.txt X_opt
 save X_pred.txt pred_val
+save weights.txt Theta1 Theta2
 
 
 
@@ -0,0 +1,86 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+/**
+    Compiled drop-in replacement of nnCostFunction.m, built with Octave's mkoctfile
+    from the repository root:
+
+        make octave/nnCostFunctionFast.oct
+
+    The forward and backward passes run on every thread with backpropagateParallel() of
+    Backpropagation.h, like the native trainer. X and y are read in place, only a batch is copied
+    out at a time.
+
+    y has to be binary (the one-hot labels of expand.m), see backpropagate(). Then the cost and
+    the gradient are the ones of nnCostFunction.m, octave/checkCostFunction.m compares the two.
+*/
+
+#include <thread>
+
+#include <octave/oct.h>
+
+#include "Backpropagation.h"
+
+DEFUN_DLD(nnCostFunctionFast, args, ,
+          "-*- texinfo -*-\n"
+          "@deftypefn {} {[@var{J}, @var{grad}] =} nnCostFunctionFast (@var{nn_params}, "
+          "@var{input_layer_size}, @var{hidden_layer_size}, @var{num_labels}, @var{X}, @var{y}, "
+          "@var{lambda}, @var{threads})\n"
+          "Same as nnCostFunction, with multithreaded blocked matrix products.\n"
+          "@var{threads} is optional, the default is the number of cores.\n"
+          "@end deftypefn") {
+    int nargin = args.length();
+    if (nargin < 7 || nargin > 8) {
+        print_usage();
+        return octave_value_list();
+    }
+    ColumnVector parameters = args(0).column_vector_value();
+    Layers layers(args(1).int_value(), args(2).int_value(), args(3).int_value());
+    Matrix x = args(4).matrix_value();
+    Matrix y = args(5).matrix_value();
+    double lambda = args(6).double_value();
+    int threads = (nargin > 7) ? args(7).int_value() : (int)std::thread::hardware_concurrency();
+    long m = x.rows();
+    if ((size_t)parameters.numel() != layers.parameters()) {
+        error("nnCostFunctionFast: nn_params doesn't match the layer sizes");
+        return octave_value_list();
+    }
+    if (x.columns() != layers.inputs || y.rows() != m || y.columns() != layers.outputs || m == 0) {
+        error("nnCostFunctionFast: X must be m x input_layer_size and y m x num_labels, m > 0");
+        return octave_value_list();
+    }
+
+    const double* theta = parameters.data();
+    const double* items = x.data();
+    const double* labels = y.data();
+    int inputs = layers.inputs;
+    int outputs = layers.outputs;
+    // [1 X] and y of a batch, column major to row major
+    auto load = [=](long first, int rows, double* batchInputs, double* batchTargets) {
+        for (int c = 0; c < inputs; ++c) {
+            const double* column = items + (size_t)c * m + first;
+            for (int r = 0; r < rows; ++r) {
+                batchInputs[(size_t)r * (inputs + 1) + c + 1] = column[r];
+            }
+        }
+        for (int o = 0; o < outputs; ++o) {
+            const double* column = labels + (size_t)o * m + first;
+            for (int r = 0; r < rows; ++r) {
+                batchTargets[(size_t)r * outputs + o] = column[r];
+            }
+        }
+    };
+    ColumnVector grad(layers.parameters(), 0.);
+    double* gradient = grad.fortran_vec();
+    ParallelScratch scratch;
+    double cost = backpropagateParallel(theta, layers, m, threads, load, gradient, scratch);
+    cost /= m;
+    for (size_t i = 0; i < layers.parameters(); ++i) {
+        gradient[i] /= m;
+    }
+    cost += regularize(theta, layers, lambda / m, gradient);
+
+    octave_value_list ret;
+    ret(0) = cost;
+    ret(1) = grad;
+    return ret;
+}
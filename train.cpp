@@ -0,0 +1,295 @@
+// Copyright (c) 2016 Simon Racz <simonracz@gmail.com>
+
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <numeric>
+#include <random>
+#include <iomanip>
+#include <thread>
+#include <chrono>
+
+#include "cxxopts.hpp"
+
+#include "Network.h"
+#include "Trainer.h"
+
+/**
+    Handles command line options.
+*/
+class Options {
+private:
+    std::string mPath;
+    std::string mWeightsPath;
+    std::string mModelPath;
+    std::string mMethod;
+    int mLength = 12;
+    int mDimension = 2;
+    int mHidden = 440;
+    double mLambda = 1;
+    int mIterations = 500;
+    int mEpochs = 20;
+    int mBatchSize = 256;
+    double mRate = 0;
+    long mSamples = 0;
+    long mValidation = 0;
+    unsigned mSeed = 0;
+    bool mSeedGiven = false;
+    int mThreads = 0;
+    bool mCheckGradient = false;
+    bool mHelp = false;
+    cxxopts::Options options;
+    void ensureConsistency() {
+        if (mHelp) {
+            return;
+        }
+        mLength = std::max(1, mLength);
+        mDimension = std::max(1, mDimension);
+        mHidden = std::max(1, mHidden);
+        mBatchSize = std::max(1, mBatchSize);
+        mSamples = std::max(0L, mSamples);
+        mValidation = std::max(0L, mValidation);
+        if (mLength > 255) {
+            throw cxxopts::OptionException("The queue length can't be more than 255.");
+        }
+        if (mPath.length() == 0) {
+            throw cxxopts::OptionException("Path to training set can't be empty.");
+        }
+        if (mMethod != "cg" && mMethod != "adam" && mMethod != "sgd") {
+            throw cxxopts::OptionException("Unknown method " + mMethod + ", use cg, adam or sgd.");
+        }
+        if (mRate <= 0) {
+            mRate = (mMethod == "sgd") ? 0.05 : 0.001;
+        }
+        mSeedGiven = options.count("seed") > 0;
+        if (!mSeedGiven) {
+            mSeed = std::random_device()();
+        }
+        if (mThreads <= 0) {
+            mThreads = std::max(1u, std::thread::hardware_concurrency());
+        }
+    }
+public:
+    Options() : options("train", "Trains the placement network of octave/main.m natively.") {
+        options.add_options()
+          ("f,file", "Training set, one-hot or compact labels", cxxopts::value<std::string>(mPath)
+                ->default_value("train.txt"))
+          ("o,output", "Theta1 and Theta2 are saved here, in Octave's text format", cxxopts::value<std::string>(mWeightsPath)
+                ->default_value("weights.txt"))
+          ("model", "Saves the network as a memory mappable model file as well (default: none)",
+                cxxopts::value<std::string>(mModelPath))
+          ("l,length", "Length of the queues (default: 12)", cxxopts::value<int>(mLength))
+          ("d,dim", "Dimension of the items (default: 2)", cxxopts::value<int>(mDimension))
+          ("hidden", "Size of the hidden layer (default: 440)", cxxopts::value<int>(mHidden))
+          ("lambda", "Regularization (default: 1)", cxxopts::value<double>(mLambda))
+          ("m,method", "cg (fmincg), adam or sgd", cxxopts::value<std::string>(mMethod)->default_value("cg"))
+          ("i,iterations", "Line searches of cg (default: 500)", cxxopts::value<int>(mIterations))
+          ("e,epochs", "Epochs of adam and sgd (default: 20)", cxxopts::value<int>(mEpochs))
+          ("b,batch", "Mini-batch size of adam and sgd (default: 256)", cxxopts::value<int>(mBatchSize))
+          ("r,rate", "Learning rate of adam and sgd (default: 0.001 and 0.05)", cxxopts::value<double>(mRate))
+          ("n,samples", "Number of random training samples (default: all but the validation ones)",
+                cxxopts::value<long>(mSamples))
+          ("validation", "Number of random samples held out for validation (default: 0)", cxxopts::value<long>(mValidation))
+          ("seed", "Seed of the initial weights and the sample selection (default: random)", cxxopts::value<unsigned>(mSeed))
+          ("j,threads", "Number of threads (default: number of cores)", cxxopts::value<int>(mThreads))
+          ("check_gradient", "Checks the gradient against central differences on a small random network and exits",
+                cxxopts::value<bool>(mCheckGradient))
+          ("h,help", "Prints help", cxxopts::value<bool>(mHelp))
+        ;
+    }
+    bool parseCMDLine(int argc, char* argv[]) {
+        try {
+            options.parse(argc, argv);
+            ensureConsistency();
+        } catch(const cxxopts::OptionException& e) {
+            std::cerr << "error parsing options: " << e.what() << std::endl;
+            return false;
+        }
+        return true;
+    }
+    std::string getPath() const {return mPath;}
+    std::string getWeightsPath() const {return mWeightsPath;}
+    std::string getModelPath() const {return mModelPath;}
+    std::string getMethod() const {return mMethod;}
+    int getLength() const {return mLength;}
+    int getDimension() const {return mDimension;}
+    int getHidden() const {return mHidden;}
+    double getLambda() const {return mLambda;}
+    int getIterations() const {return mIterations;}
+    int getEpochs() const {return mEpochs;}
+    int getBatchSize() const {return mBatchSize;}
+    double getRate() const {return mRate;}
+    long getSamples() const {return mSamples;}
+    long getValidation() const {return mValidation;}
+    unsigned getSeed() const {return mSeed;}
+    bool isSeedGiven() const {return mSeedGiven;}
+    int getThreads() const {return mThreads;}
+    bool isCheckGradient() const {return mCheckGradient;}
+    bool isHelp() const {return mHelp;}
+    std::string helpMessage() const {return options.help({""});}
+    void print() const {
+        std::cout << "options = {"
+                  << "\n  file: " << mPath
+                  << ",\n  output: " << mWeightsPath
+                  << ",\n  model: " << mModelPath
+                  << ",\n  length: " << mLength
+                  << ",\n  dimension: " << mDimension
+                  << ",\n  hidden: " << mHidden
+                  << ",\n  lambda: " << mLambda
+                  << ",\n  method: " << mMethod
+                  << ",\n  iterations: " << mIterations
+                  << ",\n  epochs: " << mEpochs
+                  << ",\n  batch: " << mBatchSize
+                  << ",\n  rate: " << mRate
+                  << ",\n  samples: " << mSamples
+                  << ",\n  validation: " << mValidation
+                  << ",\n  seed: " << mSeed
+                  << ",\n  threads: " << mThreads
+                  << ",\n  check_gradient: " << mCheckGradient
+                  << ",\n  help: " << mHelp
+                  << "\n}" << std::endl;
+    }
+};
+
+// central differences with epsilon 1e-4 agree with a right gradient to about 1e-10
+const double MaxGradientDifference = 1e-7;
+
+/**
+    The samples of 'set' at 'indices[first..last)'.
+*/
+TrainingSet select(const TrainingSet& set, const std::vector<long>& indices, long first, long last) {
+    int sampleSize = 2 * set.length * set.dimension;
+    TrainingSet ret;
+    ret.length = set.length;
+    ret.dimension = set.dimension;
+    ret.size = last - first;
+    ret.samples.reserve((size_t)ret.size * sampleSize);
+    ret.labels.reserve((size_t)ret.size * set.length);
+    for (long k = first; k < last; ++k) {
+        auto sample = set.samples.begin() + indices[k] * sampleSize;
+        ret.samples.insert(ret.samples.end(), sample, sample + sampleSize);
+        auto labels = set.labels.begin() + indices[k] * set.length;
+        ret.labels.insert(ret.labels.end(), labels, labels + set.length);
+    }
+    return ret;
+}
+
+/**
+    Percentage of the samples whose every job is predicted right, like in octave/main.m.
+*/
+double accuracy(const Network& network, const TrainingSet& set) {
+    if (set.size == 0) {
+        return 0;
+    }
+    std::vector<uint8_t> labels(set.labels.size());
+    NetworkScratch scratch;
+    network.predict(set.samples.data(), set.size, labels.data(), scratch);
+    long right = 0;
+    for (long k = 0; k < set.size; ++k) {
+        auto first = labels.begin() + k * set.length;
+        right += std::equal(first, first + set.length, set.labels.begin() + k * set.length);
+    }
+    return 100. * right / set.size;
+}
+
+int main(int argc, char* argv[]) {
+    Options opts;
+    if (!opts.parseCMDLine(argc, argv)) {
+        return 1;
+    }
+    if (opts.isHelp())
+    {
+        std::cout << opts.helpMessage() << std::endl;
+        return 0;
+    }
+    // opts.print();
+    if (opts.isCheckGradient()) {
+        double difference = checkGradient(opts.getLambda(), opts.getThreads(), opts.getSeed());
+        std::cout << "Relative difference of the analytic and the numeric gradient: " << difference
+                  << " (should be less than " << MaxGradientDifference << ")." << std::endl;
+        return difference < MaxGradientDifference ? 0 : 1;
+    }
+    int length = opts.getLength();
+    int dim = opts.getDimension();
+
+    TrainingSet all;
+    try {
+        all = readTrainingSet(opts.getPath(), length, dim, opts.getThreads());
+    } catch(const TrainerException& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    long validationSize = std::min(opts.getValidation(), all.size);
+    long trainingSize = all.size - validationSize;
+    if (opts.getSamples() > 0) {
+        trainingSize = std::min(trainingSize, opts.getSamples());
+    }
+    if (trainingSize == 0) {
+        std::cerr << "No training samples in " << opts.getPath() << "." << std::endl;
+        return 1;
+    }
+
+    // random training and validation samples, like randperm in octave/main.m
+    std::vector<long> order(all.size);
+    std::iota(order.begin(), order.end(), 0L);
+    std::mt19937 generator(opts.getSeed());
+    std::shuffle(order.begin(), order.end(), generator);
+    TrainingSet training = select(all, order, 0, trainingSize);
+    TrainingSet validation = select(all, order, all.size - validationSize, all.size);
+    all = TrainingSet();
+
+    CostFunction cost(training, opts.getHidden(), opts.getLambda(), opts.getThreads());
+    auto parameters = randomParameters(cost.inputs(), cost.hidden(), cost.outputs(), opts.getSeed());
+    std::cout << "Training on " << training.size << " samples with " << opts.getMethod() << " using "
+              << opts.getThreads() << " threads";
+    if (!opts.isSeedGiven()) {
+        // a random seed, printed so the run can be repeated with --seed
+        std::cout << ", seed " << opts.getSeed();
+    }
+    std::cout << "." << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    double finalCost = 0;
+    if (opts.getMethod() == "cg") {
+        finalCost = minimizeConjugateGradient(cost, parameters, opts.getIterations(), [] (int i, double c) {
+            std::cout << "Iteration " << std::setw(4) << i << " | Cost: " << std::scientific << std::setprecision(6)
+                      << c << std::defaultfloat << "\r" << std::flush;
+        });
+    } else {
+        DescentOptions options;
+        options.method = (opts.getMethod() == "sgd") ? DescentMethod::SGD : DescentMethod::Adam;
+        options.epochs = opts.getEpochs();
+        options.batchSize = opts.getBatchSize();
+        options.rate = opts.getRate();
+        options.seed = opts.getSeed();
+        finalCost = minimizeMiniBatch(cost, parameters, options, [] (int i, double c) {
+            std::cout << "Epoch " << std::setw(4) << i << " | Cost: " << std::scientific << std::setprecision(6)
+                      << c << std::defaultfloat << "\r" << std::flush;
+        });
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "\nTrained in " << elapsed.count() << " s, final cost " << finalCost << "." << std::endl;
+
+    try {
+        saveWeights(opts.getWeightsPath(), parameters, cost.inputs(), cost.hidden(), cost.outputs());
+    } catch(const TrainerException& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    Network network = toNetwork(parameters, length, dim, cost.hidden());
+    if (opts.getModelPath().length() > 0) {
+        try {
+            network.save(opts.getModelPath(), true);
+        } catch(const NetworkException& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+    std::cout << std::fixed << std::setprecision(6);
+    std::cout << "Training Set Accuracy: " << accuracy(network, training) << std::endl;
+    if (validation.size > 0) {
+        std::cout << "Validation Set Accuracy: " << accuracy(network, validation) << std::endl;
+    }
+    return 0;
+}